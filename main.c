@@ -7,15 +7,17 @@
 
 //the main
 int main(int argc, C_STR argv[]) {
-	if (argc == 1) {
-		repl();
+	int32_t index = parseOptions(argc, argv);
+
+	if (index < 0 || argc - index > 1) {
+		printUsage();
+		exit(64);
 	}
-	else if (argc == 2) {
-		runFile(argv[1]);
+	else if (index == argc) {
+		repl();
 	}
 	else {
-		fprintf(stderr, "Usage: [path]\n");
-		exit(64);
+		runFile(argv[index]);
 	}
 	return 0;
 }
\ No newline at end of file
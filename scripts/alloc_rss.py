@@ -0,0 +1,62 @@
+# compare the time and the peak rss of two builds on the allocation scripts,
+# e.g. one with SLAB_ALLOCATOR 1 in options.h and one with it 0
+# usage: python alloc_rss.py <flite> <flite> [script...]
+# only the standard library,wait4 on linux and macos,the process memory counters on windows
+
+import os
+import subprocess
+import sys
+import time
+
+RUNS = 3
+
+def run(flite, script):
+    begin = time.perf_counter()
+    process = subprocess.Popen([flite, script], stdout=subprocess.DEVNULL)
+
+    if os.name == "nt":
+        import ctypes
+        from ctypes import wintypes
+
+        class Counters(ctypes.Structure):
+            _fields_ = [("cb", wintypes.DWORD), ("PageFaultCount", wintypes.DWORD),
+                        ("PeakWorkingSetSize", ctypes.c_size_t), ("WorkingSetSize", ctypes.c_size_t),
+                        ("QuotaPeakPagedPoolUsage", ctypes.c_size_t), ("QuotaPagedPoolUsage", ctypes.c_size_t),
+                        ("QuotaPeakNonPagedPoolUsage", ctypes.c_size_t), ("QuotaNonPagedPoolUsage", ctypes.c_size_t),
+                        ("PagefileUsage", ctypes.c_size_t), ("PeakPagefileUsage", ctypes.c_size_t)]
+
+        process.wait()
+        seconds = time.perf_counter() - begin
+        counters = Counters()
+        counters.cb = ctypes.sizeof(Counters)
+        #the handle stays open until the popen object goes
+        ctypes.windll.kernel32.K32GetProcessMemoryInfo(wintypes.HANDLE(int(process._handle)), ctypes.byref(counters), counters.cb)
+        return seconds, counters.PeakWorkingSetSize // 1024
+
+    _, _, usage = os.wait4(process.pid, 0)
+    seconds = time.perf_counter() - begin
+    #kilobytes on linux,bytes on macos
+    rss = usage.ru_maxrss // 1024 if sys.platform == "darwin" else usage.ru_maxrss
+    return seconds, rss
+
+def main():
+    if len(sys.argv) < 3:
+        print("usage: python alloc_rss.py <flite> <flite> [script...]")
+        return 1
+
+    names = sys.argv[1:3]
+    builds = [os.path.abspath(path) for path in names]
+    os.chdir(os.path.dirname(os.path.abspath(__file__)))
+    scripts = sys.argv[3:] or ["alloc1e6_small.lox", "alloc_rss.lox"]
+
+    #the best time of the runs,the largest peak
+    for script in scripts:
+        for name, flite in zip(names, builds):
+            results = [run(flite, script) for _ in range(RUNS)]
+            seconds = min(result[0] for result in results)
+            rss = max(result[1] for result in results)
+            print("%-20s %-24s %8.3f s %10d KB" % (script, name, seconds, rss))
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
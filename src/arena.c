@@ -0,0 +1,303 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#include "arena.h"
+#include "slab.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+typedef struct ArenaRegion {
+	//the regions of a class with free blocks
+	struct ArenaRegion* prev;
+	struct ArenaRegion* next;
+	//the regions in use,full ones too
+	struct ArenaRegion* allPrev;
+	struct ArenaRegion* allNext;
+	//freed blocks,linked through their first word
+	void* freeList;
+	//blocks after it are never used
+	char* bump;
+	//the slab pages it spans
+	uint64_t pages;
+	uint64_t blockSize;
+	uint32_t used;
+	uint32_t capacity;
+	//ARENA_CLASS_COUNT for a block with a region of its own
+	uint32_t classIndex;
+} ArenaRegion;
+
+//in front of every block,a region can be larger than a slab page so masking can't find it
+typedef struct {
+	ArenaRegion* region;
+	uint64_t reserved;
+} ArenaBlock;
+
+#define ARENA_HEADER_SIZE ((sizeof(ArenaRegion) + 15) & ~(uint64_t)15)
+#define ARENA_REGION_SIZE (SLAB_PAGE_SIZE * ARENA_REGION_PAGES)
+#define ARENA_OWN_CLASS ARENA_CLASS_COUNT
+
+static ArenaRegion* available[ARENA_CLASS_COUNT];
+static ArenaRegion* usedRegions = NULL;
+static ArenaRegion* emptyRegions = NULL;
+static uint32_t emptyCount = 0;
+static uint64_t regionCount = 0;
+
+static inline uint32_t highBit(uint64_t bits) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse64(&index, bits);
+	return (uint32_t)index;
+#else
+	return 63 - (uint32_t)__builtin_clzll(bits);
+#endif
+}
+
+//the class of a block with its header,ARENA_OWN_CLASS if it is too large to share
+static inline uint32_t classOf(uint64_t size) {
+	uint64_t total = size + sizeof(ArenaBlock);
+	if (total <= (1ull << ARENA_MIN_SHIFT)) return 0;
+
+	//total is in (2^shift,2^(shift+1)]
+	uint32_t shift = highBit(total - 1);
+	if (shift > ARENA_MAX_SHIFT) return ARENA_OWN_CLASS;
+
+	uint64_t step = 1ull << (shift - 2);
+	uint64_t index = (total - (1ull << shift) + step - 1) / step;
+	return 1 + (shift - ARENA_MIN_SHIFT) * ARENA_CLASS_STEPS + (uint32_t)index - 1;
+}
+
+static inline uint64_t classSize(uint32_t classIndex) {
+	if (classIndex == 0) return 1ull << ARENA_MIN_SHIFT;
+
+	uint32_t shift = ARENA_MIN_SHIFT + (classIndex - 1) / ARENA_CLASS_STEPS;
+	uint64_t index = (classIndex - 1) % ARENA_CLASS_STEPS + 1;
+	return (1ull << shift) + index * (1ull << (shift - 2));
+}
+
+static inline void linkRegion(ArenaRegion* region) {
+	ArenaRegion** head = &available[region->classIndex];
+	region->prev = NULL;
+	region->next = *head;
+	if (*head != NULL) {
+		(*head)->prev = region;
+	}
+	*head = region;
+}
+
+static inline void unlinkRegion(ArenaRegion* region) {
+	if (region->prev != NULL) {
+		region->prev->next = region->next;
+	}
+	else {
+		available[region->classIndex] = region->next;
+	}
+	if (region->next != NULL) {
+		region->next->prev = region->prev;
+	}
+}
+
+static inline void linkUsed(ArenaRegion* region) {
+	region->allPrev = NULL;
+	region->allNext = usedRegions;
+	if (usedRegions != NULL) {
+		usedRegions->allPrev = region;
+	}
+	usedRegions = region;
+}
+
+static inline void unlinkUsed(ArenaRegion* region) {
+	if (region->allPrev != NULL) {
+		region->allPrev->allNext = region->allNext;
+	}
+	else {
+		usedRegions = region->allNext;
+	}
+	if (region->allNext != NULL) {
+		region->allNext->allPrev = region->allPrev;
+	}
+}
+
+static void unmapRegion(ArenaRegion* region) {
+	slab_unmapPages(region, region->pages);
+	regionCount--;
+}
+
+COLD_FUNCTION
+static ArenaRegion* newRegion(uint32_t classIndex) {
+	ArenaRegion* region = emptyRegions;
+
+	if (region != NULL) {
+		emptyRegions = region->next;
+		emptyCount--;
+	}
+	else {
+		region = (ArenaRegion*)slab_mapPages(ARENA_REGION_PAGES);
+		if (region == NULL) return NULL;
+		regionCount++;
+	}
+
+	region->freeList = NULL;
+	region->bump = (char*)region + ARENA_HEADER_SIZE;
+	region->pages = ARENA_REGION_PAGES;
+	region->blockSize = classSize(classIndex);
+	region->used = 0;
+	region->capacity = (uint32_t)((ARENA_REGION_SIZE - ARENA_HEADER_SIZE) / region->blockSize);
+	region->classIndex = classIndex;
+	linkRegion(region);
+	linkUsed(region);
+	return region;
+}
+
+//a block too large to share gets the pages it needs
+static ArenaRegion* ownRegion(uint64_t size) {
+	uint64_t total = ARENA_HEADER_SIZE + sizeof(ArenaBlock) + size;
+	uint64_t pages = (total + SLAB_PAGE_SIZE - 1) / SLAB_PAGE_SIZE;
+
+	ArenaRegion* region = (ArenaRegion*)slab_mapPages(pages);
+	if (region == NULL) return NULL;
+	regionCount++;
+
+	region->freeList = NULL;
+	region->bump = (char*)region + ARENA_HEADER_SIZE;
+	region->pages = pages;
+	region->blockSize = pages * SLAB_PAGE_SIZE - ARENA_HEADER_SIZE;
+	region->used = 1;
+	region->capacity = 1;
+	region->classIndex = ARENA_OWN_CLASS;
+	linkUsed(region);
+	return region;
+}
+
+static void retireRegion(ArenaRegion* region) {
+	unlinkRegion(region);
+	unlinkUsed(region);
+
+	if (emptyCount < ARENA_KEEP_REGIONS) {
+		region->next = emptyRegions;
+		emptyRegions = region;
+		emptyCount++;
+	}
+	else {
+		unmapRegion(region);
+	}
+}
+
+void arena_init()
+{
+	for (uint32_t i = 0; i < ARENA_CLASS_COUNT; ++i) {
+		available[i] = NULL;
+	}
+	usedRegions = NULL;
+	emptyRegions = NULL;
+	emptyCount = 0;
+	regionCount = 0;
+}
+
+void arena_free()
+{
+	//the blocks still in use go with their regions
+	while (usedRegions != NULL) {
+		ArenaRegion* region = usedRegions;
+		usedRegions = region->allNext;
+		unmapRegion(region);
+	}
+	for (uint32_t i = 0; i < ARENA_CLASS_COUNT; ++i) {
+		available[i] = NULL;
+	}
+
+	while (emptyRegions != NULL) {
+		ArenaRegion* region = emptyRegions;
+		emptyRegions = region->next;
+		unmapRegion(region);
+	}
+	emptyCount = 0;
+}
+
+void* arena_alloc(uint64_t size)
+{
+	uint32_t classIndex = classOf(size);
+	ArenaBlock* block;
+
+	if (classIndex == ARENA_OWN_CLASS) {
+		ArenaRegion* region = ownRegion(size);
+		if (region == NULL) return NULL;
+
+		block = (ArenaBlock*)region->bump;
+		block->region = region;
+		return block + 1;
+	}
+
+	ArenaRegion* region = available[classIndex];
+	if (region == NULL) {
+		region = newRegion(classIndex);
+		if (region == NULL) return NULL;
+	}
+
+	if (region->freeList != NULL) {
+		block = (ArenaBlock*)region->freeList;
+		region->freeList = *(void**)block;
+	}
+	else {
+		block = (ArenaBlock*)region->bump;
+		region->bump += region->blockSize;
+	}
+
+	//full regions leave the list until a block comes back
+	if (++region->used == region->capacity) {
+		unlinkRegion(region);
+	}
+
+	block->region = region;
+	return block + 1;
+}
+
+void arena_freeBlock(void* pointer)
+{
+	ArenaBlock* block = (ArenaBlock*)pointer - 1;
+	ArenaRegion* region = block->region;
+
+	if (region->classIndex == ARENA_OWN_CLASS) {
+		unlinkUsed(region);
+		unmapRegion(region);
+		return;
+	}
+
+	*(void**)block = region->freeList;
+	region->freeList = block;
+
+	if (region->used-- == region->capacity) {
+		linkRegion(region);
+	}
+
+	if (region->used == 0) {
+		retireRegion(region);
+	}
+}
+
+void* arena_realloc(void* pointer, uint64_t oldSize, uint64_t newSize)
+{
+	if (pointer == NULL) return arena_alloc(newSize);
+
+	ArenaRegion* region = ((ArenaBlock*)pointer - 1)->region;
+	uint32_t classIndex = classOf(newSize);
+	//the block already fits
+	if (classIndex == region->classIndex && (classIndex != ARENA_OWN_CLASS || newSize + sizeof(ArenaBlock) <= region->blockSize)) {
+		return pointer;
+	}
+
+	void* result = arena_alloc(newSize);
+	if (result == NULL) return NULL;
+
+	memcpy(result, pointer, (oldSize < newSize) ? oldSize : newSize);
+	arena_freeBlock(pointer);
+	return result;
+}
+
+uint64_t arena_regionCount()
+{
+	return regionCount;
+}
@@ -0,0 +1,31 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#pragma once
+#include "common.h"
+
+//the regions are made of slab pages,so they are aligned the same way
+#define ARENA_REGION_PAGES 16
+//the size classes are 4 steps between two powers of 2,the first one is 32 bytes with the header
+#define ARENA_CLASS_STEPS 4
+#define ARENA_MIN_SHIFT 5
+//blocks up to 256KB with the header share a region,larger ones get their own
+#define ARENA_MAX_SHIFT 17
+#define ARENA_CLASS_COUNT (1 + (ARENA_MAX_SHIFT - ARENA_MIN_SHIFT + 1) * ARENA_CLASS_STEPS)
+//empty regions kept for reuse,the others go back to the os
+#define ARENA_KEEP_REGIONS 4
+
+void arena_init();
+//release all regions,the blocks still in use too
+void arena_free();
+
+//size must not be 0
+void* arena_alloc(uint64_t size);
+//a new block if the size class changes,the contents are kept up to the smaller size
+void* arena_realloc(void* pointer, uint64_t oldSize, uint64_t newSize);
+void arena_freeBlock(void* pointer);
+
+//the regions mapped now
+uint64_t arena_regionCount();
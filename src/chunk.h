@@ -44,6 +44,7 @@ typedef enum {
 	OP_BITWISE,			//& | ~ ^ << >> >>>
 	OP_CALL,			// callFn
 	OP_INVOKE,			// call with xxx.()
+	OP_INVOKE_SUBSCRIPT,// call with xxx[key]()
 	OP_RETURN,          // ret
 
 	OP_SET_SUBSCRIPT,	// set subscript
@@ -53,6 +54,8 @@ typedef enum {
 	OP_GET_GLOBAL,
 	OP_SET_GLOBAL,
 	OP_DEFINE_GLOBAL,	//define global
+	OP_DEFINE_CONST_GLOBAL,	//define global constant
+	OP_GET_CONST_GLOBAL,	//load global constant by slot
 
 	OP_CLOSURE,			// getFn
 	OP_GET_UPVALUE,		//up value
@@ -68,6 +71,20 @@ typedef enum {
 	OP_METHOD,			// make class func
 
 	OP_MODULE_BUILTIN,	//load builtin module
+
+	//inline small functions
+	OP_CALL_INLINE,		// guarded call with inlined body
+	OP_INVOKE_INLINE,	// guarded invoke with inlined body
+	OP_GET_INLINE_LOCAL,// load local of the inlined body
+	OP_RETURN_INLINE,	// leave the inlined body
+	OP_FREE_INLINE_LOCAL,// free the owned object of a local of the inlined body
+
+	//array loops
+	OP_GET_ELEM_UNCHECKED,	// get array element,checked by the loop condition
+	OP_SET_ELEM_UNCHECKED,	// set array element,checked by the loop condition
+
+	//escape analysis
+	OP_FREE_LOCAL,		// free the object of a local,nothing else refers to it
 } OpCode;
 
 typedef enum {
@@ -80,6 +97,13 @@ typedef enum {
 	BIT_OP_SAR,			//>>
 } BitOpCode;
 
+//the operand of OP_CLOSURE for each upvalue
+typedef enum {
+	CAPTURE_UPVALUE,	//copy the upvalue of enclosing closure
+	CAPTURE_LOCAL,		//capture the local by reference
+	CAPTURE_LOCAL_FLAT,	//copy the local by value,it is never assigned
+} CaptureType;
+
 typedef struct {
 	uint32_t count;    //limit to 4G
 	uint32_t capacity; //limit to 4G
@@ -16,6 +16,17 @@ Parser parser;
 Compiler* current = NULL;
 ClassCompiler* currentClass = NULL;
 
+//name -> constant index of inlinable global functions
+Table inlineFunctions;
+//name -> constant index of inlinable methods,false if the name is ambiguous
+Table inlineMethods;
+//names of the global constants in source,they can't be assigned even before declared
+Table constNames;
+//names of the global variables declared so far in source,a constant can't take them
+Table globalNames;
+//the global constants from this slot are declared after the lazy function being compiled
+uint32_t visibleConstCount = UINT32_MAX;
+
 static void declaration();
 static void expression();
 static void statement();
@@ -118,6 +129,11 @@ static void emitConstantCommond(OpCode target, uint32_t index) {
 	}
 }
 
+//read the 16-bit operand
+static uint32_t readShortAt(int32_t offset) {
+	return ((uint32_t)currentChunk()->code[offset]) | ((uint32_t)currentChunk()->code[offset + 1] << 8);
+}
+
 static int32_t emitJump(uint8_t instruction) {
 	emitByte(instruction);
 	emitBytes(2, 0xff, 0xff);
@@ -134,10 +150,21 @@ static void emitLoop(int32_t loopStart) {
 	emitBytes(2, offset & 0xff, (offset >> 8) & 0xff);
 }
 
+//free the owned objects of the locals in scope,unless a later use in a loop around the return may let one escape first
+static void emitLocalFrees() {
+	for (uint32_t i = 0; i < current->localCount; ++i) {
+		Local* local = &current->locals[i];
+		if (local->ownsObject && local->loop == current->currentLoop) {
+			emitBytes(2, OP_FREE_LOCAL, (uint8_t)i);
+		}
+	}
+}
+
 static void emitReturn() {
+	emitLocalFrees();
 	if (current->type == TYPE_INITIALIZER) {
-		//16bits index get_local
-		emitBytes(4, OP_GET_LOCAL, 0, 0, OP_RETURN);
+		//8bits index get_local
+		emitBytes(3, OP_GET_LOCAL, 0, OP_RETURN);
 	}
 	else {
 		emitBytes(2, OP_NIL, OP_RETURN);
@@ -201,12 +228,14 @@ static void patchJump(int32_t offset) {
 	currentChunk()->code[offset + 1] = (jump >> 8) & 0xff;
 }
 
-static void initCompiler(Compiler* compiler, FunctionType type) {
+//function is null for a new one,or the lazy function to compile
+static void initCompiler(Compiler* compiler, FunctionType type, ObjFunction* function) {
 	compiler->enclosing = current;
 	current = compiler;//must set now
 
 	//init
 	compiler->currentLoop = NULL;
+	compiler->arrayLoop = NULL;
 
 	compiler->function = NULL;
 	compiler->type = type;
@@ -217,17 +246,31 @@ static void initCompiler(Compiler* compiler, FunctionType type) {
 	compiler->locals = ALLOCATE_NO_GC(Local, LOCAL_INIT);
 	compiler->localCapacity = LOCAL_INIT;
 
-	compiler->function = newFunction();
+	compiler->function = (function != NULL) ? function : newFunction();
 	compiler->objectNestingDepth = 0;
-
-	//it's a function
-	if (type == TYPE_FUNCTION) {
+	compiler->lastGlobalGet = -1;
+	compiler->lastLocalGet = -1;
+	compiler->lastLiteralStart = -1;
+	compiler->lastLiteralEnd = -1;
+	compiler->receiverLocal = -1;
+
+	compiler->patchCount = 0;
+	compiler->patchCapacity = 0;
+	compiler->patches = NULL;
+
+	//it's a function or method
+	if (type != TYPE_SCRIPT && function == NULL) {
 		compiler->function->name = copyString(parser.previous.start, parser.previous.length, false);
 	}
 
 	Local* local = &compiler->locals[compiler->localCount++];
 	local->depth = 0;
 	local->isCaptured = false;
+	local->isAssigned = false;
+	local->isConst = false;
+	local->isLiteral = false;
+	local->ownsObject = false;
+	local->loop = NULL;
 
 	if (type != TYPE_FUNCTION) {
 		local->name.start = "this";
@@ -253,12 +296,116 @@ static void freeLocals(Compiler* compiler) {
 	FREE_ARRAY_NO_GC(Local, compiler->locals, compiler->localCapacity);
 	compiler->locals = NULL;
 	compiler->localCapacity = 0;
+
+	FREE_ARRAY_NO_GC(CapturePatch, compiler->patches, compiler->patchCapacity);
+	compiler->patches = NULL;
+	compiler->patchCapacity = 0;
+	compiler->patchCount = 0;
+}
+
+//offset is the capture type of OP_CLOSURE in current chunk
+static void addCapturePatch(uint32_t offset, uint16_t local) {
+	if (current->patchCount == current->patchCapacity) {
+		uint32_t oldCapacity = current->patchCapacity;
+		current->patchCapacity = GROW_CAPACITY(oldCapacity);
+		current->patches = GROW_ARRAY_NO_GC(CapturePatch, current->patches, oldCapacity, current->patchCapacity);
+	}
+
+	current->patches[current->patchCount++] = (CapturePatch){ .offset = offset, .local = local };
+}
+
+//the local goes out of scope,if it's never assigned the captures copy the value
+static void resolveCaptures(uint16_t local) {
+	bool isFlat = !current->locals[local].isAssigned;
+
+	for (uint32_t i = 0; i < current->patchCount;) {
+		CapturePatch* patch = &current->patches[i];
+
+		if (patch->local == local) {
+			if (isFlat) {
+				currentChunk()->code[patch->offset] = CAPTURE_LOCAL_FLAT;
+			}
+			//remove it
+			*patch = current->patches[--current->patchCount];
+		}
+		else {
+			++i;
+		}
+	}
+}
+
+//the length of an instruction that can be inlined, 0 if it can't
+static uint32_t inlineInstructionLength(uint8_t instruction) {
+	switch (instruction) {
+	case OP_ADD: case OP_SUBTRACT: case OP_MULTIPLY: case OP_DIVIDE: case OP_MODULUS:
+	case OP_NOT: case OP_NEGATE: case OP_NIL: case OP_TRUE: case OP_FALSE:
+	case OP_EQUAL: case OP_GREATER: case OP_LESS: case OP_NOT_EQUAL:
+	case OP_LESS_EQUAL: case OP_GREATER_EQUAL: case OP_POP: case OP_TYPE_OF:
+	case OP_GET_SUBSCRIPT: case OP_SET_SUBSCRIPT: case OP_NEW_OBJECT:
+		return 1;
+	case OP_GET_LOCAL: case OP_BITWISE: case OP_NEW_ARRAY: case OP_MODULE_BUILTIN: case OP_FREE_LOCAL:
+		return 2;
+	case OP_CONSTANT: case OP_GET_PROPERTY: case OP_SET_PROPERTY: case OP_NEW_PROPERTY:
+	case OP_GET_GLOBAL: case OP_SET_GLOBAL: case OP_GET_CONST_GLOBAL:
+	case OP_JUMP: case OP_JUMP_IF_FALSE: case OP_JUMP_IF_FALSE_POP: case OP_JUMP_IF_TRUE:
+		return 3;
+	default://calls,loops,closures,upvalues and local writes are not inlined
+		return 0;
+	}
+}
+
+//a body is inlinable when it has no calls,loops or captures and returns only at the end
+static uint16_t inlineBodySize(ObjFunction* function) {
+	Chunk* chunk = &function->chunk;
+	if (function->upvalueCount != 0) return 0;
+
+	//find the first return,all the code before it must be inlinable
+	uint32_t end = 0;
+	while (end < chunk->count && chunk->code[end] != OP_RETURN) {
+		uint32_t length = inlineInstructionLength(chunk->code[end]);
+		if (length == 0) return 0;
+		end += length;
+	}
+
+	if (end == 0 || end > INLINE_BODY_MAX) return 0;
+	//only the implicit 'return nil' may follow,after the frees of the locals
+	uint32_t rest = end + 1;
+	while (rest + 1 < chunk->count && chunk->code[rest] == OP_FREE_LOCAL) {
+		rest += 2;
+	}
+	if ((rest != chunk->count) && (rest + 2 != chunk->count || chunk->code[rest] != OP_NIL)) return 0;
+
+	//jumps must stay inside the body
+	for (uint32_t offset = 0; offset < end; offset += inlineInstructionLength(chunk->code[offset])) {
+		switch (chunk->code[offset]) {
+		case OP_JUMP:
+		case OP_JUMP_IF_FALSE:
+		case OP_JUMP_IF_FALSE_POP:
+		case OP_JUMP_IF_TRUE: {
+			uint32_t jump = ((uint32_t)chunk->code[offset + 1]) | ((uint32_t)chunk->code[offset + 2] << 8);
+			if (offset + 3 + jump > end) return 0;
+			break;
+		}
+		}
+	}
+
+	return (uint16_t)end;
 }
 
 static ObjFunction* endCompiler() {
 	emitReturn();
 
+	//the rest locals live until return
+	for (uint32_t i = 0; i < current->localCount; ++i) {
+		if (current->locals[i].isCaptured) {
+			resolveCaptures(i);
+		}
+	}
+
 	ObjFunction* function = current->function;
+	if (current->type == TYPE_FUNCTION || current->type == TYPE_METHOD) {
+		function->inlineSize = inlineBodySize(function);
+	}
 #if DEBUG_PRINT_CODE
 	if (!parser.hadError) {
 		disassembleChunk(currentChunk(), (function->name != NULL)
@@ -289,7 +436,17 @@ static void endScope() {
 	uint32_t popCount = 0;
 
 	while ((current->localCount > 0) && (current->locals[current->localCount - 1].depth > current->scopeDepth)) {
-		if (current->locals[current->localCount - 1].isCaptured) {
+		Local* local = &current->locals[current->localCount - 1];
+		if (local->isCaptured) {
+			resolveCaptures(current->localCount - 1);
+		}
+		//every use has been seen,nothing else refers to the object
+		if (local->ownsObject) {
+			emitBytes(2, OP_FREE_LOCAL, (uint8_t)(current->localCount - 1));
+		}
+
+		//flat captures don't need to close
+		if (local->isCaptured && local->isAssigned) {
 			if (popCount > 0) {
 				emitPopCount(popCount);
 				popCount = 0;
@@ -342,6 +499,78 @@ static uint32_t identifierConstant(Token* name) {
 	return makeConstant(OBJ_VAL(copyString(name->start, name->length, false)));
 }
 
+static bool isConstName(ObjString* name) {
+	Value value;
+	return tableGet(&vm.constGlobalSlots, name, &value) || tableGet(&constNames, name, &value);
+}
+
+//the declared global constant,null if it's not declared yet
+static ConstGlobal* getConstGlobal(ObjString* name, uint32_t* slot) {
+	Value value;
+	if (!tableGet(&vm.constGlobalSlots, name, &value)) return NULL;
+
+	*slot = (uint32_t)AS_NUMBER(value);
+	return (*slot < visibleConstCount) ? &vm.constGlobals[*slot] : NULL;
+}
+
+static uint32_t addConstGlobal(ObjString* name, bool isLiteral, Value value) {
+	if (vm.constGlobalCount > UINT16_MAX) {
+		error("Too many global constants.");
+		return 0;
+	}
+
+	if (vm.constGlobalCount == vm.constGlobalCapacity) {
+		uint32_t oldCapacity = vm.constGlobalCapacity;
+		vm.constGlobalCapacity = GROW_CAPACITY(oldCapacity);
+		vm.constGlobals = GROW_ARRAY_NO_GC(ConstGlobal, vm.constGlobals, oldCapacity, vm.constGlobalCapacity);
+	}
+
+	vm.constGlobals[vm.constGlobalCount] = (ConstGlobal){ .name = name, .value = isLiteral ? value : NIL_VAL, .isLiteral = isLiteral, .isDefined = false };
+	tableSet(&vm.constGlobalSlots, name, NUMBER_VAL(vm.constGlobalCount));
+	return vm.constGlobalCount++;
+}
+
+//the global constants of a failed compilation are dropped
+static void removeConstGlobals(uint32_t begin) {
+	while (vm.constGlobalCount > begin) {
+		tableDelete(&vm.constGlobalSlots, vm.constGlobals[--vm.constGlobalCount].name);
+	}
+}
+
+//find the names of global constants,so the assignments before the declaration are errors too
+static void scanConstNames(C_STR source) {
+	if (strstr(source, "const") == NULL) return;
+
+	scanner_init(source, 1);
+	uint32_t depth = 0; //braces,parentheses and brackets
+	bool isDeclaring = false; //in the declaration list of global constants
+	bool isName = false; //the next identifier is a name
+
+	for (Token token = scanToken(); token.type != TOKEN_EOF; token = scanToken()) {
+		switch (token.type) {
+		case TOKEN_LEFT_BRACE: case TOKEN_LEFT_PAREN: case TOKEN_LEFT_SQUARE_BRACKET:
+			depth++;
+			break;
+		case TOKEN_RIGHT_BRACE: case TOKEN_RIGHT_PAREN: case TOKEN_RIGHT_SQUARE_BRACKET:
+			if (depth > 0) depth--;
+			break;
+		case TOKEN_SEMICOLON:
+			if (depth == 0) isDeclaring = false;
+			break;
+		case TOKEN_IDENTIFIER:
+			if (isName) {
+				tableSet(&constNames, copyString(token.start, token.length, false), BOOL_VAL(true));
+			}
+			break;
+		default:
+			break;
+		}
+
+		isName = (depth == 0) && ((token.type == TOKEN_CONST) || (isDeclaring && token.type == TOKEN_COMMA));
+		if (token.type == TOKEN_CONST && depth == 0) isDeclaring = true;
+	}
+}
+
 static void addLocal(Token name) {
 	if (current->localCount == LOCAL_MAX) {
 		error("Too many nested local variables in scope.");
@@ -359,6 +588,11 @@ static void addLocal(Token name) {
 	local->name = name;
 	local->depth = -1;// var a = a;??? avoid this
 	local->isCaptured = false;
+	local->isAssigned = false;
+	local->isConst = false;
+	local->isLiteral = false;
+	local->ownsObject = false;
+	local->loop = NULL;
 }
 
 static bool identifiersEqual(Token* a, Token* b) {
@@ -435,6 +669,7 @@ static LocalInfo resolveUpvalue(Compiler* compiler, Token* name) {
 	LocalInfo localInfo = resolveLocal(compiler->enclosing, name);
 	if (localInfo.arg != -1) {
 		compiler->enclosing->locals[localInfo.arg].isCaptured = true;//mark it as captured
+		compiler->enclosing->locals[localInfo.arg].ownsObject = false;
 		localInfo.arg = addUpvalue(compiler, localInfo.arg, true);
 		return localInfo;
 	}
@@ -449,6 +684,72 @@ static LocalInfo resolveUpvalue(Compiler* compiler, Token* name) {
 	return (LocalInfo) { .arg = -1 };
 }
 
+//the local is assigned after declared
+static void markLocalAssigned(Compiler* compiler, uint32_t index) {
+	compiler->locals[index].isAssigned = true;
+	compiler->locals[index].ownsObject = false;
+
+	//the array loops can't trust the condition anymore
+	for (ArrayLoop* loop = compiler->arrayLoop; loop != NULL; loop = loop->enclosing) {
+		if (loop->arrayLocal == index || loop->indexLocal == index) {
+			loop->isReassigned = true;
+		}
+	}
+}
+
+//the upvalue captures a constant
+static bool isUpvalueConst(Compiler* compiler, uint32_t index) {
+	Upvalue* upvalue = &compiler->upvalues[index];
+
+	return upvalue->isLocal
+		? compiler->enclosing->locals[upvalue->index].isConst
+		: isUpvalueConst(compiler->enclosing, upvalue->index);
+}
+
+//the name is a literal constant of the enclosing functions,no need to capture it
+static bool resolveEnclosingLiteral(Compiler* compiler, Token* name, Value* value) {
+	for (; compiler != NULL; compiler = compiler->enclosing) {
+		for (int32_t i = compiler->localCount - 1; i >= 0; i--) {
+			Local* local = &compiler->locals[i];
+
+			if (identifiersEqual(name, &local->name)) {
+				*value = local->value;
+				return local->isLiteral;
+			}
+		}
+	}
+	return false;
+}
+
+//the captured local is assigned through the upvalue
+static void markUpvalueAssigned(Compiler* compiler, uint32_t index) {
+	Upvalue* upvalue = &compiler->upvalues[index];
+
+	if (upvalue->isLocal) {
+		markLocalAssigned(compiler->enclosing, upvalue->index);
+	}
+	else {
+		markUpvalueAssigned(compiler->enclosing, upvalue->index);
+	}
+}
+
+//a global can't be declared again after a constant with the same name
+static void checkConstGlobal(uint32_t global) {
+	Value value;
+	if (tableGet(&vm.constGlobalSlots, AS_STRING(vm.constants.values[global]), &value)) {
+		error("Already a constant with this name.");
+	}
+}
+
+//and a constant can't be declared after a global,the ones of the earlier scripts count too
+static void checkGlobalVariable(uint32_t global) {
+	ObjString* name = AS_STRING(vm.constants.values[global]);
+	Value value;
+	if (tableGet(&globalNames, name, &value) || tableGet(&vm.globals.fields, name, &value)) {
+		error("Already a variable with this name.");
+	}
+}
+
 static uint32_t parseVariable(C_STR errorMessage) {
 	consume(TOKEN_IDENTIFIER, errorMessage);
 
@@ -456,7 +757,9 @@ static uint32_t parseVariable(C_STR errorMessage) {
 	//it is a local one
 	if (current->scopeDepth > 0) return 0;
 
-	return identifierConstant(&parser.previous);
+	uint32_t global = identifierConstant(&parser.previous);
+	checkConstGlobal(global);
+	return global;
 }
 
 static void markInitialized() {
@@ -472,6 +775,7 @@ static void defineVariable(uint32_t global) {
 		return;
 	}
 
+	tableSet(&globalNames, AS_STRING(vm.constants.values[global]), BOOL_VAL(true));
 	emitConstantCommond(OP_DEFINE_GLOBAL, global);
 }
 
@@ -513,14 +817,12 @@ static void block() {
 	consume(TOKEN_RIGHT_BRACE, "Expect '}' after block.");
 }
 
-static void function(FunctionType type) {
-	Compiler compiler;
-	initCompiler(&compiler, type);
+//return the constant index of the function
+//parameters and body
+static void functionBody() {
 	beginScope();
 
-	if (type == TYPE_FUNCTION) {
-		consume(TOKEN_LEFT_PAREN, "Expect '(' after function name.");
-	}
+	consume(TOKEN_LEFT_PAREN, "Expect '(' after function name.");
 
 	if (!check(TOKEN_RIGHT_PAREN)) {
 		do {
@@ -538,19 +840,67 @@ static void function(FunctionType type) {
 	consume(TOKEN_RIGHT_PAREN, "Expect ')' after parameters.");
 	consume(TOKEN_LEFT_BRACE, "Expect '{' before function body.");
 	block();
+}
+
+static uint32_t function(FunctionType type) {
+	Compiler compiler;
+	initCompiler(&compiler, type, NULL);
+	functionBody();
 
 	ObjFunction* function = endCompiler();
+	uint32_t constant = makeConstant(OBJ_VAL(function));
 
 	//create a closure
-	emitConstantCommond(OP_CLOSURE, makeConstant(OBJ_VAL(function)));
+	emitConstantCommond(OP_CLOSURE, constant);
 
 	//insert upValue index
 	for (uint32_t i = 0; i < function->upvalueCount; i++) {
-		emitByte(compiler.upvalues[i].isLocal ? 1 : 0);
+		if (compiler.upvalues[i].isLocal) {
+			addCapturePatch(currentChunk()->count, compiler.upvalues[i].index);
+		}
+		emitByte(compiler.upvalues[i].isLocal ? CAPTURE_LOCAL : CAPTURE_UPVALUE);
 		emitBytes(2, (uint8_t)(compiler.upvalues[i].index), (uint8_t)(compiler.upvalues[i].index >> 8));
 	}
 
 	freeLocals(&compiler);
+	return constant;
+}
+
+//the callee value must be on the stack,then the args,then the guard and body
+static void emitInlineBody(ObjFunction* function) {
+	Chunk* body = &function->chunk;
+
+	//skip the body if the guard fails
+	uint16_t skip = function->inlineSize + 1;
+	emitBytes(2, (uint8_t)skip, (uint8_t)(skip >> 8));
+
+	for (uint32_t offset = 0; offset < function->inlineSize;) {
+		uint8_t instruction = body->code[offset];
+		uint32_t length = inlineInstructionLength(instruction);
+
+		//the slots are relative to the callee on the stack
+		switch (instruction) {
+		case OP_GET_LOCAL: emitByte(OP_GET_INLINE_LOCAL); break;
+		case OP_FREE_LOCAL: emitByte(OP_FREE_INLINE_LOCAL); break;
+		default: emitByte(instruction); break;
+		}
+		for (uint32_t i = 1; i < length; ++i) {
+			emitByte(body->code[offset + i]);
+		}
+
+		offset += length;
+	}
+
+	emitByte(OP_RETURN_INLINE);
+}
+
+//find the inlinable function,null if none
+static ObjFunction* getInlineFunction(Table* table, ObjString* name, uint32_t* constant) {
+	Value value;
+	if (!tableGet(table, name, &value) || !IS_NUMBER(value)) return NULL;
+
+	*constant = (uint32_t)AS_NUMBER(value);
+	return AS_FUNCTION(vm.constants.values[*constant]);
 }
 
 static void method() {
@@ -561,8 +911,21 @@ static void method() {
 	if (parser.previous.length == 4 && memcmp(parser.previous.start, "init", 4) == 0) {
 		type = TYPE_INITIALIZER;
 	}
-	function(type);
+	uint32_t functionConstant = function(type);
 	emitConstantCommond(OP_METHOD, constant);
+
+	//record it,the same name from different classes can't be inlined
+	ObjFunction* compiled = AS_FUNCTION(vm.constants.values[functionConstant]);
+	if (type == TYPE_METHOD) {
+		ObjString* name = AS_STRING(vm.constants.values[constant]);
+		Value value;
+		if (compiled->inlineSize > 0 && !tableGet(&inlineMethods, name, &value)) {
+			tableSet(&inlineMethods, name, NUMBER_VAL(functionConstant));
+		}
+		else {
+			tableSet(&inlineMethods, name, BOOL_VAL(false));
+		}
+	}
 }
 
 static void classDeclaration() {
@@ -571,6 +934,9 @@ static void classDeclaration() {
 
 	uint32_t nameConstant = identifierConstant(&parser.previous);
 	declareVariable();
+	if (current->scopeDepth == 0) {
+		checkConstGlobal(nameConstant);
+	}
 
 	emitConstantCommond(OP_CLASS, nameConstant);
 	defineVariable(nameConstant);
@@ -593,16 +959,86 @@ static void classDeclaration() {
 	currentClass = currentClass->enclosing;
 }
 
+#if LAZY_COMPILE
+//the body is only checked for balanced braces and compiled on the first call
+//globals of script have nothing to capture,the names in body are resolved as globals
+static uint32_t lazyFunction() {
+	ObjFunction* function = newFunction();
+	function->name = copyString(parser.previous.start, parser.previous.length, false);
+
+	C_STR start = parser.current.start;
+	uint32_t line = parser.current.line;
+
+	//parameters
+	while (!check(TOKEN_LEFT_BRACE) && !check(TOKEN_EOF)) {
+		advance();
+	}
+
+	//body
+	uint32_t depth = 0;
+	do {
+		if (check(TOKEN_EOF)) {
+			errorAtCurrent("Expect '}' after block.");
+			break;
+		}
+
+		if (check(TOKEN_LEFT_BRACE)) {
+			depth++;
+		}
+		else if (check(TOKEN_RIGHT_BRACE)) {
+			depth--;
+		}
+		advance();
+	} while (depth > 0);
+
+	uint32_t length = (uint32_t)(parser.previous.start + parser.previous.length - start);
+	LazyBody* lazy = (LazyBody*)reallocate_no_gc(NULL, 0, sizeof(LazyBody) + length + 1);
+	lazy->line = line;
+	lazy->constCount = vm.constGlobalCount;
+	lazy->length = length;
+	memcpy(lazy->source, start, length);
+	lazy->source[length] = '\0';
+	function->lazy = lazy;
+
+	uint32_t constant = makeConstant(OBJ_VAL(function));
+	emitConstantCommond(OP_CLOSURE, constant);
+	return constant;
+}
+#endif
+
 static void funDeclaration() {
 	uint32_t arg = parseVariable("Expect function name.");
 	markInitialized();
-	function(TYPE_FUNCTION);
+#if LAZY_COMPILE
+	uint32_t constant = (current->enclosing == NULL && current->scopeDepth == 0)
+		? lazyFunction() : function(TYPE_FUNCTION);
+#else
+	uint32_t constant = function(TYPE_FUNCTION);
+#endif
+
+	//it's captured by itself before the closure is stored
+	if (current->scopeDepth > 0 && current->locals[current->localCount - 1].isCaptured) {
+		current->locals[current->localCount - 1].isAssigned = true;
+	}
+
+	//only the globals of script can be inlined,calls are guarded in case of reassignment
+	if (current->enclosing == NULL && current->scopeDepth == 0) {
+		ObjFunction* compiled = AS_FUNCTION(vm.constants.values[constant]);
+		if (compiled->inlineSize > 0) {
+			tableSet(&inlineFunctions, compiled->name, NUMBER_VAL(constant));
+		}
+		else {
+			tableDelete(&inlineFunctions, compiled->name);
+		}
+	}
+
 	defineVariable(arg);
 }
 
 static void varDeclaration() {
 	do {
 		uint32_t arg = parseVariable("Expect variable name.");
+		int32_t start = currentChunk()->count;
 
 		if (match(TOKEN_EQUAL)) {
 			expression();
@@ -611,6 +1047,13 @@ static void varDeclaration() {
 			emitByte(OP_NIL);
 		}
 
+		//the initializer is just an object or array literal
+		if (current->scopeDepth > 0 && current->lastLiteralStart == start && current->lastLiteralEnd == (int32_t)currentChunk()->count) {
+			Local* local = &current->locals[current->localCount - 1];
+			local->ownsObject = true;
+			local->loop = current->currentLoop;
+		}
+
 		defineVariable(arg);
 
 		if (parser.hadError) return;
@@ -619,18 +1062,124 @@ static void varDeclaration() {
 	consume(TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
 }
 
+//the initializer is a literal or a negative number
+static bool literalValue(int32_t start, Value* value) {
+	uint8_t* code = &currentChunk()->code[start];
+	uint32_t length = currentChunk()->count - start;
+
+	if (length == 1) {
+		switch (code[0]) {
+		case OP_NIL: *value = NIL_VAL; return true;
+		case OP_TRUE: *value = BOOL_VAL(true); return true;
+		case OP_FALSE: *value = BOOL_VAL(false); return true;
+		default: return false;
+		}
+	}
+
+	if ((length == 3 || length == 4) && code[0] == OP_CONSTANT) {
+		*value = vm.constants.values[readShortAt(start + 1)];
+		if (length == 3) return true;
+
+		if (code[3] == OP_NEGATE && IS_NUMBER(*value)) {
+			*value = NUMBER_VAL(-AS_NUMBER(*value));
+			return true;
+		}
+	}
+	return false;
+}
+
+//the uses of a literal constant load the value,the others are immutable slots
+static void constDeclaration() {
+	do {
+		uint32_t global = parseVariable("Expect constant name.");
+		if (current->scopeDepth == 0) checkGlobalVariable(global);
+		consume(TOKEN_EQUAL, "Expect '=' after constant name.");
+
+		int32_t start = currentChunk()->count;
+		expression();
+
+		Value value = NIL_VAL;
+		bool isLiteral = literalValue(start, &value);
+
+		if (current->scopeDepth > 0) {
+			Local* local = &current->locals[current->localCount - 1];
+			local->isConst = true;
+			local->isLiteral = isLiteral;
+			local->value = value;
+			markInitialized();
+		}
+		else {
+			uint32_t slot = addConstGlobal(AS_STRING(vm.constants.values[global]), isLiteral, value);
+			emitConstantCommond(OP_DEFINE_CONST_GLOBAL, slot);
+		}
+	} while (match(TOKEN_COMMA));
+
+	consume(TOKEN_SEMICOLON, "Expect ';' after constant declaration.");
+}
+
 static void expressionStatement() {
 	expression();
 	consume(TOKEN_SEMICOLON, "Expect ';' after expression.");
 	emitByte(OP_POP);
 }
 
+static bool isNonNegativeConstant(uint32_t index) {
+	Value value = vm.constants.values[index];
+	return IS_NUMBER(value) && AS_NUMBER(value) >= 0;
+}
+
+//match for(var i = c; i < @array.length(arr); i = i + k) with c >= 0 and k >= 0
+//then i is a non negative number and arr is an array when the condition is true
+static bool matchArrayLoop(ArrayLoop* loop, int32_t initStart, int32_t conditionStart, int32_t incrementStart, int32_t incrementEnd) {
+	uint8_t* code = currentChunk()->code;
+
+	//var i = c;
+	if (conditionStart - initStart != 3 || code[initStart] != OP_CONSTANT) return false;
+	if (!isNonNegativeConstant(readShortAt(initStart + 1))) return false;
+	uint8_t index = (uint8_t)(current->localCount - 1);
+
+	//i < @array.length(arr)
+	if (incrementStart - conditionStart != 11 + 3 + 3) return false; //condition,OP_JUMP_IF_FALSE_POP,OP_JUMP
+	if (code[conditionStart] != OP_GET_LOCAL || code[conditionStart + 1] != index) return false;
+	if (code[conditionStart + 2] != OP_MODULE_BUILTIN || code[conditionStart + 3] != MODULE_ARRAY) return false;
+	if (code[conditionStart + 4] != OP_GET_LOCAL || code[conditionStart + 5] == index) return false;
+	if (code[conditionStart + 6] != OP_INVOKE || code[conditionStart + 9] != 1) return false;
+	if (code[conditionStart + 10] != OP_LESS) return false;
+
+	ObjString* name = AS_STRING(vm.constants.values[readShortAt(conditionStart + 7)]);
+	if (name->length != 6 || memcmp(name->chars, "length", 6) != 0) return false;
+
+	//i = i + k
+	if (incrementEnd - incrementStart != 8) return false;
+	if (code[incrementStart] != OP_GET_LOCAL || code[incrementStart + 1] != index) return false;
+	if (code[incrementStart + 2] != OP_CONSTANT || !isNonNegativeConstant(readShortAt(incrementStart + 3))) return false;
+	if (code[incrementStart + 5] != OP_ADD) return false;
+	if (code[incrementStart + 6] != OP_SET_LOCAL || code[incrementStart + 7] != index) return false;
+
+	loop->arrayLocal = code[conditionStart + 5];
+	loop->indexLocal = index;
+	return true;
+}
+
+//the loop body may run the accesses again after a call,so stop trusting the condition
+static void invalidateArrayLoop() {
+	if (current->arrayLoop != NULL) {
+		current->arrayLoop->isValid = false;
+	}
+}
+
 static void forStatement() {
+	//the body of an outer array loop runs this loop many times
+	invalidateArrayLoop();
+
 	//for is a block
 	beginScope();
 
 	consume(TOKEN_LEFT_PAREN, "Expect '(' after 'for'.");
 
+	int32_t initStart = currentChunk()->count;
+	uint32_t initLocalCount = current->localCount;
+
 	if (match(TOKEN_SEMICOLON)) { //like this -> for(;;)
 		// No initializer.
 	}
@@ -642,6 +1191,7 @@ static void forStatement() {
 	}
 
 	int32_t loopStart = currentChunk()->count;
+	int32_t conditionStart = loopStart;
 
 	int32_t exitJump = -1;
 	if (!match(TOKEN_SEMICOLON)) {//for(; here ;)
@@ -652,12 +1202,21 @@ static void forStatement() {
 		exitJump = emitJump(OP_JUMP_IF_FALSE_POP);
 	}
 
+	bool isArrayLoop = false;
+	ArrayLoop arrayLoop = (ArrayLoop){ .isValid = false,.isReassigned = false,.accessCount = 0,.accessCapacity = 0,.accesses = NULL,.enclosing = current->arrayLoop };
+
 	//the code is: init,condition,increase,body,loop_to_increase
 	if (!match(TOKEN_RIGHT_PAREN)) { // for(;;here)
 		//we don't do increase first,we go to body first
 		int32_t bodyJump = emitJump(OP_JUMP);
 		int32_t incrementStart = currentChunk()->count;
 		expression();
+
+		if (exitJump != -1 && current->localCount == initLocalCount + 1) {
+			isArrayLoop = matchArrayLoop(&arrayLoop, initStart, conditionStart, incrementStart, currentChunk()->count);
+			arrayLoop.isValid = isArrayLoop;
+		}
+
 		emitByte(OP_POP);
 
 		consume(TOKEN_RIGHT_PAREN, "Expect ')' after for clauses.");
@@ -676,9 +1235,26 @@ static void forStatement() {
 	loop.breakJumps = ALLOCATE_NO_GC(int32_t, loop.breakJumpCapacity);
 	current->currentLoop = &loop;
 
+	if (isArrayLoop) {
+		current->arrayLoop = &arrayLoop;
+	}
+
 	statement();
 	emitLoop(loopStart);
 
+	if (isArrayLoop) {
+		//the assignment may happen before the accesses in the next iteration
+		if (arrayLoop.isReassigned) {
+			for (uint32_t i = 0; i < arrayLoop.accessCount; ++i) {
+				uint8_t* instruction = &currentChunk()->code[arrayLoop.accesses[i]];
+				*instruction = (*instruction == OP_GET_ELEM_UNCHECKED) ? OP_GET_SUBSCRIPT : OP_SET_SUBSCRIPT;
+			}
+		}
+
+		FREE_ARRAY_NO_GC(int32_t, arrayLoop.accesses, arrayLoop.accessCapacity);
+		current->arrayLoop = arrayLoop.enclosing;
+	}
+
 	//if there is no exitJump,this is an infinite loop
 	if (exitJump != -1) {
 		patchJump(exitJump);
@@ -741,6 +1317,7 @@ static void returnStatement() {
 
 		expression();
 		consume(TOKEN_SEMICOLON, "Expect ';' after return value.");
+		emitLocalFrees();
 		emitByte(OP_RETURN);
 	}
 }
@@ -793,6 +1370,7 @@ static void synchronize() {
 		case TOKEN_CLASS:
 		case TOKEN_FUN:
 		case TOKEN_VAR:
+		case TOKEN_CONST:
 		case TOKEN_FOR:
 		case TOKEN_BRANCH:
 		case TOKEN_RETURN:
@@ -845,6 +1423,9 @@ static void declaration() {
 	else if (match(TOKEN_VAR)) {
 		varDeclaration();
 	}
+	else if (match(TOKEN_CONST)) {
+		constDeclaration();
+	}
 	else {
 		statement();
 	}
@@ -881,11 +1462,33 @@ static void binary(bool canAssign) {
 }
 
 static void call(bool canAssign) {
+	ObjFunction* inlineFunction = NULL;
+	uint32_t constant = 0;
+
+	//the callee is a global just loaded
+	int32_t calleeOffset = current->lastGlobalGet;
+	if (calleeOffset != -1 && calleeOffset + 3 == currentChunk()->count) {
+		uint32_t name = ((uint32_t)currentChunk()->code[calleeOffset + 1]) | ((uint32_t)currentChunk()->code[calleeOffset + 2] << 8);
+		inlineFunction = getInlineFunction(&inlineFunctions, AS_STRING(vm.constants.values[name]), &constant);
+	}
+
 	uint8_t argCount = argumentList();
-	emitBytes(2, OP_CALL, argCount);
+	invalidateArrayLoop();
+
+	if (inlineFunction != NULL && inlineFunction->arity == argCount) {
+		emitBytes(2, OP_CALL_INLINE, argCount);
+		emitBytes(2, (uint8_t)constant, (uint8_t)(constant >> 8));
+		emitInlineBody(inlineFunction);
+	}
+	else {
+		emitBytes(2, OP_CALL, argCount);
+	}
 }
 
 static void dot(bool canAssign) {
+	int32_t receiver = current->receiverLocal;
+	current->receiverLocal = -1;
+
 	consume(TOKEN_IDENTIFIER, "Expect property name after '.'.");
 	uint32_t name = identifierConstant(&parser.previous);
 
@@ -894,9 +1497,25 @@ static void dot(bool canAssign) {
 		emitConstantCommond(OP_SET_PROPERTY, name);
 	}
 	else if (match(TOKEN_LEFT_PAREN)) {
+		//the method gets the receiver
+		if (receiver != -1) {
+			current->locals[receiver].ownsObject = false;
+		}
+
 		uint8_t argCount = argumentList();
-		emitConstantCommond(OP_INVOKE, name);
-		emitByte(argCount);
+		invalidateArrayLoop();
+		uint32_t constant = 0;
+		ObjFunction* inlineFunction = getInlineFunction(&inlineMethods, AS_STRING(vm.constants.values[name]), &constant);
+
+		if (inlineFunction != NULL && inlineFunction->arity == argCount) {
+			emitConstantCommond(OP_INVOKE_INLINE, name);
+			emitBytes(3, argCount, (uint8_t)constant, (uint8_t)(constant >> 8));
+			emitInlineBody(inlineFunction);
+		}
+		else {
+			emitConstantCommond(OP_INVOKE, name);
+			emitByte(argCount);
+		}
 	}
 	else {
 		emitConstantCommond(OP_GET_PROPERTY, name);
@@ -904,6 +1523,7 @@ static void dot(bool canAssign) {
 }
 
 static void arrayLiteral(bool canAssign) {
+	int32_t start = currentChunk()->count;
 	uint32_t elementCount = 0;
 	if (!check(TOKEN_RIGHT_SQUARE_BRACKET) && !check(TOKEN_EOF)) {
 		do {
@@ -921,6 +1541,8 @@ static void arrayLiteral(bool canAssign) {
 	}
 
 	emitBytes(2, OP_NEW_ARRAY, (uint8_t)elementCount);  //make array
+	current->lastLiteralStart = start;
+	current->lastLiteralEnd = currentChunk()->count;
 }
 
 static void objectLiteral(bool canAssign) {
@@ -930,6 +1552,7 @@ static void objectLiteral(bool canAssign) {
 	}
 
 	++current->objectNestingDepth;
+	int32_t start = currentChunk()->count;
 	emitByte(OP_NEW_OBJECT);
 
 	if (!check(TOKEN_RIGHT_BRACE) && !check(TOKEN_EOF)) {
@@ -962,17 +1585,69 @@ static void objectLiteral(bool canAssign) {
 
 	consume(TOKEN_RIGHT_BRACE, "Expect '}' to close the object.");
 	--current->objectNestingDepth;
+	current->lastLiteralStart = start;
+	current->lastLiteralEnd = currentChunk()->count;
+}
+
+//the last instruction loads the local
+static bool isLocalGet(int32_t offset, uint16_t local) {
+	return current->lastLocalGet == offset && currentChunk()->code[offset + 1] == local;
+}
+
+//arr[i] in the body of the array loop,the condition has checked it
+static bool isCheckedAccess(bool isArrayGet) {
+	ArrayLoop* loop = current->arrayLoop;
+	return loop != NULL && loop->isValid && isArrayGet;
+}
+
+static void emitAccess(OpCode checked, OpCode unchecked, bool isArrayGet) {
+	if (isCheckedAccess(isArrayGet)) {
+		ArrayLoop* loop = current->arrayLoop;
+
+		if (loop->accessCount == loop->accessCapacity) {
+			uint32_t oldCapacity = loop->accessCapacity;
+			loop->accessCapacity = GROW_CAPACITY(oldCapacity);
+			loop->accesses = GROW_ARRAY_NO_GC(int32_t, loop->accesses, oldCapacity, loop->accessCapacity);
+		}
+
+		loop->accesses[loop->accessCount++] = currentChunk()->count;
+		emitByte(unchecked);
+	}
+	else {
+		emitByte(checked);
+	}
 }
 
 static void subscript(bool canAssign) {
+	int32_t receiver = current->receiverLocal;
+	current->receiverLocal = -1;
+	//the target is just the array of the loop
+	int32_t targetOffset = currentChunk()->count - 2;
+	bool isArrayGet = current->arrayLoop != NULL && isLocalGet(targetOffset, current->arrayLoop->arrayLocal);
+
+	int32_t indexStart = currentChunk()->count;
 	expression();
+	//the subscript is just the index of the loop
+	isArrayGet = isArrayGet && currentChunk()->count == indexStart + 2 && isLocalGet(indexStart, current->arrayLoop->indexLocal);
+
 	consume(TOKEN_RIGHT_SQUARE_BRACKET, "Expect ']' after subscript.");
 	if (canAssign && match(TOKEN_EQUAL)) {
 		expression(); // parse assignment
-		emitByte(OP_SET_SUBSCRIPT);
+		emitAccess(OP_SET_SUBSCRIPT, OP_SET_ELEM_UNCHECKED, isArrayGet);
+	}
+	else if (match(TOKEN_LEFT_PAREN)) {
+		//the method gets the receiver
+		if (receiver != -1) {
+			current->locals[receiver].ownsObject = false;
+		}
+
+		//no bound method in between
+		uint8_t argCount = argumentList();
+		invalidateArrayLoop();
+		emitBytes(2, OP_INVOKE_SUBSCRIPT, argCount);
 	}
 	else {
-		emitByte(OP_GET_SUBSCRIPT);
+		emitAccess(OP_GET_SUBSCRIPT, OP_GET_ELEM_UNCHECKED, isArrayGet);
 	}
 }
 
@@ -1043,25 +1718,55 @@ static void namedVariable(Token name, bool canAssign) {
 	LocalInfo args = resolveLocal(current, &name);
 	int32_t arg = args.arg;
 
+	Value literal;
+
 	if (arg != -1) {//it's a local var
+		Local* local = &current->locals[arg];
 
 		if (canAssign && match(TOKEN_EQUAL)) {
+			if (local->isConst) {
+				error("Can't assign to constant.");
+			}
+
 			expression();
+			markLocalAssigned(current, arg);
 
 			// 8-bit index
 			emitBytes(2, OP_SET_LOCAL, (uint8_t)arg);
 		}
+		else if (local->isLiteral) {
+			emitConstant(local->value);
+		}
 		else { // 8-bit index
+			//the object stays owned if it's only accessed by field or index
+			if (local->ownsObject) {
+				if (check(TOKEN_DOT) || check(TOKEN_LEFT_SQUARE_BRACKET)) {
+					current->receiverLocal = arg;
+				}
+				else {
+					local->ownsObject = false;
+				}
+			}
+
+			current->lastLocalGet = currentChunk()->count;
 			emitBytes(2, OP_GET_LOCAL, (uint8_t)arg);
 		}
 	}
+	else if (!(canAssign && check(TOKEN_EQUAL)) && resolveEnclosingLiteral(current->enclosing, &name, &literal)) {
+		emitConstant(literal);
+	}
 	else {
 		args = resolveUpvalue(current, &name);
 		arg = args.arg;
 
 		if (arg != -1) {//it's an upvalue
 			if (canAssign && match(TOKEN_EQUAL)) {
+				if (isUpvalueConst(current, arg)) {
+					error("Can't assign to constant.");
+				}
+
 				expression();
+				markUpvalueAssigned(current, arg);
 				// 16-bit index
 				emitBytes(2, OP_SET_UPVALUE, (uint8_t)arg);
 			}
@@ -1071,12 +1776,28 @@ static void namedVariable(Token name, bool canAssign) {
 		}
 		else {//it's a global var
 			arg = identifierConstant(&name);
+			ObjString* string = AS_STRING(vm.constants.values[arg]);
+			ConstGlobal* global = NULL;
+			uint32_t slot = 0;
 
 			if (canAssign && match(TOKEN_EQUAL)) {
+				if (isConstName(string)) {
+					error("Can't assign to constant.");
+				}
+
 				expression();
 				emitConstantCommond(OP_SET_GLOBAL, arg);
 			}
+			else if ((global = getConstGlobal(string, &slot)) != NULL) {
+				if (global->isLiteral) {
+					emitConstant(global->value);
+				}
+				else {
+					emitConstantCommond(OP_GET_CONST_GLOBAL, slot);
+				}
+			}
 			else {
+				current->lastGlobalGet = currentChunk()->count;
 				emitConstantCommond(OP_GET_GLOBAL, arg);
 			}
 		}
@@ -1159,6 +1880,7 @@ ParseRule rules[] = {
 	[TOKEN_MODULE_SYSTEM] = {builtinLiteral,     NULL,   PREC_NONE},
 	[TOKEN_AND] = {NULL,     and_,   PREC_AND},
 	[TOKEN_CLASS] = {NULL,     NULL,   PREC_NONE},
+	[TOKEN_CONST] = {NULL,     NULL,   PREC_NONE},
 	[TOKEN_FALSE] = {literal,     NULL,   PREC_NONE},
 	[TOKEN_FOR] = {NULL,     NULL,   PREC_NONE},
 	[TOKEN_FUN] = {NULL,     NULL,   PREC_NONE},
@@ -1183,8 +1905,19 @@ static ParseRule* getRule(TokenType type) {
 ObjFunction* compile(C_STR source) {
 	Compiler compiler;
 
-	scanner_init(source);
-	initCompiler(&compiler, TYPE_SCRIPT);
+	table_init(&constNames);
+	constNames.type = TABLE_NORMAL;
+	scanConstNames(source);
+	table_init(&globalNames);
+	globalNames.type = TABLE_NORMAL;
+	uint32_t constGlobalCount = vm.constGlobalCount;
+
+	scanner_init(source, 1);
+	table_init(&inlineFunctions);
+	table_init(&inlineMethods);
+	inlineFunctions.type = TABLE_NORMAL;
+	inlineMethods.type = TABLE_NORMAL;
+	initCompiler(&compiler, TYPE_SCRIPT, NULL);
 
 	//init flags
 	parser.hadError = false;
@@ -1199,10 +1932,60 @@ ObjFunction* compile(C_STR source) {
 
 	ObjFunction* function = endCompiler();
 	freeLocals(&compiler);
+	table_free(&inlineFunctions);
+	table_free(&inlineMethods);
+	table_free(&constNames);
+	table_free(&globalNames);
+
+	if (parser.hadError) {
+		removeConstGlobals(constGlobalCount);
+	}
 
 	return parser.hadError ? NULL : function;
 }
 
+bool compileLazy(ObjFunction* function) {
+	LazyBody* lazy = function->lazy;
+	Compiler compiler;
+
+	scanner_init(lazy->source, lazy->line);
+	//the inline tables of script are gone,the calls in body are not inlined
+	table_init(&inlineFunctions);
+	table_init(&inlineMethods);
+	inlineFunctions.type = TABLE_NORMAL;
+	inlineMethods.type = TABLE_NORMAL;
+	initCompiler(&compiler, TYPE_FUNCTION, function);
+	//the global constants declared later are loaded by name
+	visibleConstCount = lazy->constCount;
+
+	//init flags
+	parser.hadError = false;
+	parser.panicMode = false;
+
+	advance();
+	functionBody();
+	consume(TOKEN_EOF, "Expect end of function body.");
+
+	endCompiler();
+	visibleConstCount = UINT32_MAX;
+	freeLocals(&compiler);
+	table_free(&inlineFunctions);
+	table_free(&inlineMethods);
+
+	if (parser.hadError) {
+		//try again on the next call
+		chunk_free(&function->chunk);
+		chuck_init(&function->chunk);
+		function->arity = 0;
+		function->inlineSize = 0;
+		return false;
+	}
+
+	FREE_FLEX_NO_GC(LazyBody, lazy, char, lazy->length + 1);
+	function->lazy = NULL;
+	return true;
+}
+
 void markCompilerRoots()
 {
 	Compiler* compiler = current;
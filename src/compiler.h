@@ -17,6 +17,8 @@
 #define OBJECT_MAX_NESTING 12
 //function nesting
 #define FUNCTION_MAX_NESTING 8
+//inlinable function body (bytes)
+#define INLINE_BODY_MAX 32
 
 typedef struct {
 	Token current;
@@ -55,8 +57,20 @@ typedef struct {
 	Token name;
 	int32_t depth;
 	bool isCaptured; //captured by upvalue
+	bool isAssigned; //assigned after declared,can't be captured flat
+	bool isConst; //declared by const,can't be assigned
+	bool isLiteral; //const with a literal value,the uses load the value
+	bool ownsObject; //holds a fresh object or array literal that no other value refers to
+	Value value; //the literal value
+	struct LoopContext* loop; //the loop it is declared in
 } Local;
 
+//the capture type of OP_CLOSURE is known when the local goes out of scope
+typedef struct {
+	uint32_t offset; //offset of the capture type
+	uint16_t local; //index of the captured local
+} CapturePatch;
+
 typedef struct LoopContext{
 	int32_t start;
 	uint32_t enterParamCount;
@@ -66,6 +80,18 @@ typedef struct LoopContext{
 	struct LoopContext* enclosing;
 } LoopContext;
 
+//for(var i = c; i < @array.length(arr); i = i + k),the condition checks the array and the index
+typedef struct ArrayLoop {
+	uint16_t arrayLocal;
+	uint16_t indexLocal;
+	bool isValid; //no call or nested loop since the condition,new accesses can skip the checks
+	bool isReassigned; //the array or the index is assigned in the body,all accesses must be checked
+	uint32_t accessCount;
+	uint32_t accessCapacity;
+	int32_t* accesses; //offsets of the unchecked accesses
+	struct ArrayLoop* enclosing;
+} ArrayLoop;
+
 typedef enum {
 	TYPE_FUNCTION,
 	TYPE_METHOD, //class method
@@ -92,6 +118,17 @@ typedef struct Compiler {
 	Local* locals;
 
 	LoopContext* currentLoop;
+	ArrayLoop* arrayLoop;
+
+	uint32_t patchCount;
+	uint32_t patchCapacity;
+	CapturePatch* patches;
+
+	int32_t lastGlobalGet; //offset of the last OP_GET_GLOBAL,used to find inline calls
+	int32_t lastLocalGet; //offset of the last OP_GET_LOCAL,used to find unchecked accesses
+	int32_t lastLiteralStart; //code range of the last object or array literal,used to find fresh objects
+	int32_t lastLiteralEnd;
+	int32_t receiverLocal; //the owning local just loaded for a property access or subscript,-1 if none
 	Upvalue upvalues[UINT8_COUNT];
 } Compiler;
 
@@ -100,4 +137,5 @@ typedef struct ClassCompiler {
 } ClassCompiler;
 
 ObjFunction* compile(C_STR source);
+bool compileLazy(ObjFunction* function);
 void markCompilerRoots();
\ No newline at end of file
@@ -86,6 +86,14 @@ static uint32_t shortInstruction(C_STR name, Chunk* chunk, uint32_t offset) {
 	return offset + 3;
 }
 
+COLD_FUNCTION
+static uint32_t constGlobalInstruction(C_STR name, Chunk* chunk, uint32_t offset) {
+	uint32_t slot = ((uint32_t)chunk->code[offset + 1]) | ((uint32_t)chunk->code[offset + 2] << 8);
+
+	printf("%-16s %4d '%s'\n", name, slot, vm.constGlobals[slot].name->chars);
+	return offset + 3;
+}
+
 COLD_FUNCTION
 static uint32_t constantInstruction(C_STR name, Chunk* chunk, uint32_t offset) {
 	//24bit index
@@ -110,6 +118,31 @@ static uint32_t invokeInstruction(C_STR name, Chunk* chunk, uint32_t offset) {
 	return offset + 4;
 }
 
+COLD_FUNCTION
+static uint32_t callInlineInstruction(C_STR name, Chunk* chunk, uint32_t offset) {
+	uint8_t argCount = chunk->code[offset + 1];
+	uint32_t constant = ((uint32_t)chunk->code[offset + 2]) | ((uint32_t)chunk->code[offset + 3] << 8);
+	uint32_t skip = ((uint32_t)chunk->code[offset + 4]) | ((uint32_t)chunk->code[offset + 5] << 8);
+	printf("%-16s (%d args) %4d '", name, argCount, constant);
+	printValue(vm.constants.values[constant]);
+	printf("' -> %d\n", offset + 6 + skip);
+	return offset + 6;
+}
+
+COLD_FUNCTION
+static uint32_t invokeInlineInstruction(C_STR name, Chunk* chunk, uint32_t offset) {
+	uint32_t method = ((uint32_t)chunk->code[offset + 1]) | ((uint32_t)chunk->code[offset + 2] << 8);
+	uint8_t argCount = chunk->code[offset + 3];
+	uint32_t constant = ((uint32_t)chunk->code[offset + 4]) | ((uint32_t)chunk->code[offset + 5] << 8);
+	uint32_t skip = ((uint32_t)chunk->code[offset + 6]) | ((uint32_t)chunk->code[offset + 7] << 8);
+	printf("%-16s (%d args) %4d '", name, argCount, method);
+	printValue(vm.constants.values[method]);
+	printf("' %4d '", constant);
+	printValue(vm.constants.values[constant]);
+	printf("' -> %d\n", offset + 8 + skip);
+	return offset + 8;
+}
+
 COLD_FUNCTION
 uint32_t disassembleInstruction(Chunk* chunk, uint32_t offset) {
 	printf("%04d ", offset);
@@ -128,6 +161,8 @@ uint32_t disassembleInstruction(Chunk* chunk, uint32_t offset) {
 		return byteInstruction("OP_CALL", chunk, offset);
 	case OP_INVOKE:
 		return invokeInstruction("OP_INVOKE", chunk, offset);
+	case OP_INVOKE_SUBSCRIPT:
+		return byteInstruction("OP_INVOKE_SUBSCRIPT", chunk, offset);
 	case OP_RETURN:
 		return simpleInstruction("OP_RETURN", offset);
 	case OP_POP:
@@ -166,7 +201,7 @@ uint32_t disassembleInstruction(Chunk* chunk, uint32_t offset) {
 			index |= (chunk->code[offset++] << 8);
 
 			printf("%04d      |                     %s %d\n",
-				offset - 3, isLocal ? "local" : "upvalue", index);
+				offset - 3, isLocal == CAPTURE_LOCAL_FLAT ? "flat" : (isLocal ? "local" : "upvalue"), index);
 		}
 		return offset;
 	}
@@ -202,6 +237,10 @@ uint32_t disassembleInstruction(Chunk* chunk, uint32_t offset) {
 
 	case OP_DEFINE_GLOBAL:
 		return constantInstruction("OP_DEFINE_GLOBAL", chunk, offset);
+	case OP_DEFINE_CONST_GLOBAL:
+		return constGlobalInstruction("OP_DEFINE_CONST_GLOBAL", chunk, offset);
+	case OP_GET_CONST_GLOBAL:
+		return constGlobalInstruction("OP_GET_CONST_GLOBAL", chunk, offset);
 	case OP_GET_GLOBAL:
 		return constantInstruction("OP_GET_GLOBAL", chunk, offset);
 	case OP_SET_GLOBAL:
@@ -217,6 +256,10 @@ uint32_t disassembleInstruction(Chunk* chunk, uint32_t offset) {
 
 	case OP_GET_SUBSCRIPT:
 		return simpleInstruction("OP_GET_SUBSCRIPT", offset);
+	case OP_GET_ELEM_UNCHECKED:
+		return simpleInstruction("OP_GET_ELEM_UNCHECKED", offset);
+	case OP_SET_ELEM_UNCHECKED:
+		return simpleInstruction("OP_SET_ELEM_UNCHECKED", offset);
 	case OP_SET_SUBSCRIPT:
 		return simpleInstruction("OP_SET_SUBSCRIPT", offset);
 
@@ -243,6 +286,18 @@ uint32_t disassembleInstruction(Chunk* chunk, uint32_t offset) {
 		return jumpInstruction("OP_LOOP", -1, chunk, offset);
 	case OP_MODULE_BUILTIN:
 		return builtinInStruction("OP_MODULE", chunk, offset);
+	case OP_CALL_INLINE:
+		return callInlineInstruction("OP_CALL_INLINE", chunk, offset);
+	case OP_INVOKE_INLINE:
+		return invokeInlineInstruction("OP_INVOKE_INLINE", chunk, offset);
+	case OP_GET_INLINE_LOCAL:
+		return byteInstruction("OP_GET_INLINE_LOCAL", chunk, offset);
+	case OP_FREE_INLINE_LOCAL:
+		return byteInstruction("OP_FREE_INLINE_LOCAL", chunk, offset);
+	case OP_FREE_LOCAL:
+		return byteInstruction("OP_FREE_LOCAL", chunk, offset);
+	case OP_RETURN_INLINE:
+		return simpleInstruction("OP_RETURN_INLINE", offset);
 	default:
 		printf("Unknown opcode %d offset = %d\n", instruction, offset);
 		return offset + 1;
@@ -6,6 +6,33 @@
 #include "entrance.h"
 #include "version.h"
 #include "vm.h"
+#include "gc.h"
+#include "snapshot.h"
+#include "profiler.h"
+
+//where the heap stats go when the vm is freed,NULL for nowhere
+static C_STR heapStatsPath = NULL;
+#if ALLOC_PROFILER
+//where the allocation profile goes when the vm is freed,NULL for off
+static C_STR allocProfilePath = NULL;
+static uint64_t allocSampleRate = PROFILER_SAMPLE_RATE;
+#endif
+
+static void freeVM() {
+	if (heapStatsPath != NULL) {
+		dumpHeapStats(heapStatsPath);
+	}
+#if ALLOC_PROFILER
+	//the names of the functions go with the vm
+	if (allocProfilePath != NULL) {
+		if (!profiler_write(allocProfilePath)) {
+			fprintf(stderr, "Could not write the allocation profile \"%s\".\n", allocProfilePath);
+		}
+		profiler_stop();
+	}
+#endif
+	vm_free();
+}
 
 static void print_help() {
 	printf("Commands:\n");
@@ -208,10 +235,102 @@ void repl() {
 
 	free(fullLine);
 
-	vm_free();
+	freeVM();
 #undef match_string
 }
 
+void printUsage() {
+	fprintf(stderr, "Usage: [options] [path]\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "  --gc-heap-begin=<size>  The first major gc threshold.\n");
+	fprintf(stderr, "  --gc-heap-min=<size>    The threshold is never lower.\n");
+	fprintf(stderr, "  --gc-heap-max=<size>    The threshold is never higher.\n");
+	fprintf(stderr, "  --gc-heap-limit=<size>  A runtime error if the heap can't stay under it.\n");
+	fprintf(stderr, "  --gc-grow=<factor>      The threshold is the live bytes times it.\n");
+	fprintf(stderr, "  --gc-adaptive[=on|off]  Pick the grow factor from the time spent in the gc.\n");
+	fprintf(stderr, "  --gc-max-pause=<us>     The longest incremental step in microseconds,0 only limits the work.\n");
+	fprintf(stderr, "  --gc-threads=<count>    The threads of a full gc,up to %d if built with GC_THREADS > 1.\n", GC_MAX_THREADS);
+	fprintf(stderr, "  --heap-stats[=<path>]   Write the heap stats as json at exit,to stderr without a path.\n");
+#if ALLOC_PROFILER
+	fprintf(stderr, "  --alloc-profile=<path>  Write the sampled allocation sites at exit,pprof for .pb or .pprof,else folded stacks.\n");
+	fprintf(stderr, "  --alloc-sample=<size>   The mean bytes between two samples,0 records every allocation.\n");
+#endif
+	fprintf(stderr, "  --heap-analyze=<path>   Print the largest retained sizes of a heap snapshot and exit.\n");
+	fprintf(stderr, "A size is in bytes,with an optional K,M or G suffix.\n");
+	fprintf(stderr, "The same options are read from FLITE_GC_HEAP_BEGIN,FLITE_GC_GROW,FLITE_HEAP_STATS and so on.\n");
+}
+
+int32_t parseOptions(int32_t argc, C_STR argv[]) {
+	if (!loadGCEnvironment()) return -1;
+	heapStatsPath = getenv("FLITE_HEAP_STATS");
+#if ALLOC_PROFILER
+	allocProfilePath = getenv("FLITE_ALLOC_PROFILE");
+	C_STR sample = getenv("FLITE_ALLOC_SAMPLE");
+	if (sample != NULL && !parseSize(sample, &allocSampleRate)) {
+		fprintf(stderr, "Invalid value \"%s\" of FLITE_ALLOC_SAMPLE.\n", sample);
+		return -1;
+	}
+#endif
+
+	int32_t index = 1;
+	for (; index < argc && strncmp(argv[index], "--", 2) == 0; ++index) {
+		C_STR option = argv[index] + 2;
+		if (strcmp(option, "help") == 0) {
+			printUsage();
+			exit(0);
+		}
+		//nothing runs,the file is read and the report printed
+		if (strncmp(option, "heap-analyze=", 13) == 0) {
+			exit(snapshot_analyze(option + 13) ? 0 : 1);
+		}
+#if ALLOC_PROFILER
+		if (strncmp(option, "alloc-profile=", 14) == 0) {
+			allocProfilePath = option + 14;
+			continue;
+		}
+		if (strncmp(option, "alloc-sample=", 13) == 0) {
+			if (!parseSize(option + 13, &allocSampleRate)) {
+				fprintf(stderr, "Invalid option \"%s\".\n", argv[index]);
+				return -1;
+			}
+			continue;
+		}
+#endif
+		if (strncmp(option, "heap-stats", 10) == 0 && (option[10] == '\0' || option[10] == '=')) {
+			heapStatsPath = (option[10] == '=') ? option + 11 : "-";
+			continue;
+		}
+		if (strncmp(option, "gc-", 3) != 0) {
+			fprintf(stderr, "Unknown option \"%s\".\n", argv[index]);
+			return -1;
+		}
+		option += 3;
+
+		//the name is copied,so it can end at the '='
+		char name[32];
+		C_STR equal = strchr(option, '=');
+		uint64_t length = (equal != NULL) ? (uint64_t)(equal - option) : strlen(option);
+		if (length >= sizeof(name)) length = sizeof(name) - 1;
+		memcpy(name, option, length);
+		name[length] = '\0';
+
+		//a switch without a value is on
+		C_STR value = (equal != NULL) ? equal + 1 : "on";
+		if (!setGCOption(name, value)) {
+			fprintf(stderr, "Invalid option \"%s\".\n", argv[index]);
+			return -1;
+		}
+	}
+
+#if ALLOC_PROFILER
+	//the compiler's allocations are profiled too
+	if (allocProfilePath != NULL) {
+		profiler_start(allocSampleRate);
+	}
+#endif
+	return index;
+}
+
 void runFile(C_STR path) {
 	vm_init();
 
@@ -219,8 +338,9 @@ void runFile(C_STR path) {
 	InterpretResult result = interpret(source);
 	free(source);
 
+	//the vm is dropped by regions,so it's cheap on the error paths too
+	freeVM();
+
 	if (result == INTERPRET_COMPILE_ERROR) exit(65);
 	if (result == INTERPRET_RUNTIME_ERROR) exit(70);
-
-	vm_free();
 }
\ No newline at end of file
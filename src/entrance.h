@@ -7,4 +7,7 @@
 #include "common.h"
 
 void repl();
-void runFile(C_STR path);
\ No newline at end of file
+void runFile(C_STR path);
+void printUsage();
+//apply the environment and the leading --gc-*,--heap-* and --alloc-* options,returns the index of the path or -1
+int32_t parseOptions(int32_t argc, C_STR argv[]);
\ No newline at end of file
@@ -7,10 +7,116 @@
 #include "vm.h"
 #include "compiler.h"
 #include "memory.h"
+#include "heap.h"
+#include "large.h"
+#include "timer.h"
+#include <time.h>
+#if GC_CONCURRENT || GC_THREADS > 1
+#include <threads.h>
+#endif
 
 //Flip tagging, although the performance is not high (about 4% gap), is more suitable for concurrent tagging
 uint8_t usingMark = 1;
-uint64_t gc_heap_begin = GC_HEAP_BEGIN;
+GCPolicy gcPolicy = {
+	.heapBegin = GC_HEAP_BEGIN,
+	.heapMin = GC_HEAP_BEGIN,
+	.heapMax = 0,
+	.heapLimit = 0,
+	.growFactor = GC_HEAP_GROW_FACTOR,
+	.adaptive = false,
+	.maxPause = GC_MAX_PAUSE_US,
+	.threads = GC_THREADS,
+};
+GCStats gcStats = { 0 };
+//the pauses since the last major gc ended,only counted by the adaptive policy
+//in nanoseconds of wall time,the time of the marking threads isn't a pause
+static uint64_t pauseNanos = 0;
+static uint64_t pauseBegin = 0;
+static uint64_t cycleBegin = 0;
+//the grow factor picked by the adaptive policy,0 before the first pick
+static double adaptiveFactor = 0;
+//a minor gc only traces young objects,the old ones are kept by the remembered set
+static bool isMinorGC = false;
+uint8_t gcPhase = GC_IDLE;
+//the next page to sweep
+static HeapPage* sweepCursor = NULL;
+//the large array being scanned by the steps
+static ObjArray* scanArray = NULL;
+static uint32_t scanIndex = 0;
+//the heap when the marking finished and the bytes freed by the sweep since
+static uint64_t markedBytes = 0;
+static uint64_t sweptBytes = 0;
+//the young objects freed when the marking finished
+static uint64_t youngFreedBytes = 0;
+//of the running collection,for the stats
+static uint64_t freedObjects = 0;
+static uint64_t youngSurvivors = 0;
+
+#if GC_CONCURRENT
+static thrd_t markThread;
+//guards the gray stack and the buffers of tables and arrays while the thread runs
+static mtx_t markLock;
+static bool markLockReady = false;
+//only the mutator changes it
+static bool markThreadRunning = false;
+//set by the thread with the lock held
+static bool markThreadDone = false;
+#endif
+
+#if GC_THREADS > 1
+typedef struct {
+	uint64_t count;
+	uint64_t capacity;
+	Obj** stack;
+} GrayStack;
+
+//the gray objects a marker lets the others steal,only its owner adds to them
+typedef struct {
+	mtx_t lock;
+	GrayStack gray;
+} WorkDeque;
+
+//the gray stack of a parallel marker,NULL on the mutator
+static _Thread_local GrayStack* workerGray = NULL;
+_Thread_local int64_t* gcFreedBytes = NULL;
+
+//one deque for each marker,the lock and the counts below are for the markers running out of work
+static WorkDeque workDeques[GC_MAX_THREADS];
+static mtx_t workLock;
+static cnd_t workCond;
+static bool workLockReady = false;
+//the threads of this collection,from gcPolicy.threads
+static uint32_t workerThreads = 0;
+static uint32_t workerCount = 0;
+static uint32_t idleWorkers = 0;
+//bumped when a marker fills its deque,so the idle ones look again
+static uint64_t workVersion = 0;
+static bool markDone = false;
+
+//the pages the parallel sweep splits
+static HeapPage** sweepPages = NULL;
+static uint64_t sweepPageCount = 0;
+static uint64_t sweepPageCapacity = 0;
+
+static void pushGray(GrayStack* gray, Obj* object) {
+	if (gray->capacity < gray->count + 1) {
+		gray->capacity = GROW_CAPACITY(gray->capacity);
+		gray->stack = (Obj**)mem_realloc(gray->stack, sizeof(Obj*) * gray->capacity);
+		if (gray->stack == NULL) exit(1);//realloc failed
+	}
+
+	gray->stack[gray->count++] = object;
+}
+
+//another marker may reach it at the same time,so claim the mark
+static void markObjectParallel(Obj* object) {
+	if (object->isStatic) return;
+
+	if (heap_getMark(object) == usingMark) return;
+	if (heap_setMark(object, usingMark) == usingMark) return;
+	pushGray(workerGray, object);
+}
+#endif
 
 void markValue(Value value)
 {
@@ -60,6 +166,9 @@ static void markRoots() {
 	}
 
 	markTable(&vm.globals.fields);
+	for (uint32_t i = 0; i < vm.constGlobalCount; i++) {
+		markValue(vm.constGlobals[i].value);
+	}
 	//the shared constants don't gc
 	//markConstants(&vm.constants);
 
@@ -72,24 +181,25 @@ void markObject(Obj* object)
 {
 	//skip the null and things that don't need mark
 	if (object == NULL) return;
-	//skip marked one
-	if (object->isMarked == usingMark) return;
-
-	switch (object->type) {
-	case OBJ_FUNCTION:
-	case OBJ_NATIVE:
-	case OBJ_STRING:
-		//don't join gc
-		//object->isMarked = true;
+#if GC_THREADS > 1
+	if (workerGray != NULL) {
+		markObjectParallel(object);
 		return;
 	}
+#endif
+	//strings,functions,natives and the vm's own objects don't join gc
+	if (object->isStatic) return;
+	//old objects survive a minor gc anyway
+	if (isMinorGC && object->isOld) return;
+	//skip marked one
+	if (heap_getMark(object) == usingMark) return;
 
 #if DEBUG_LOG_GC
 	printf("[gc] %p mark ", (void*)object);
 	printValue(OBJ_VAL(object));
 	printf("\n");
 #endif
-	object->isMarked = usingMark;
+	heap_setMark(object, usingMark);
 
 	if (vm.grayCapacity < vm.grayCount + 1) {
 		vm.grayCapacity = GROW_CAPACITY(vm.grayCapacity);
@@ -101,7 +211,8 @@ void markObject(Obj* object)
 	vm.grayStack[vm.grayCount++] = object;
 }
 
-static void blackenObject(Obj* object) {
+//returns the slots scanned
+static uint64_t blackenObject(Obj* object) {
 #if DEBUG_LOG_GC
 	printf("[gc] %p blacken ", (void*)object);
 	printValue(OBJ_VAL(object));
@@ -112,23 +223,24 @@ static void blackenObject(Obj* object) {
 	case OBJ_UPVALUE: {
 		//When an upvalue is closed, it contains a reference to the closed-over value
 		markValue(((ObjUpvalue*)object)->closed);
-		break;
+		return 1;
 	}
 	case OBJ_CLOSURE: {
 		ObjClosure* closure = (ObjClosure*)object;
 		//no need
 		//markObject((Obj*)closure->function);
 
+		//flat values or upvalues
 		for (uint32_t i = 0; i < closure->upvalueCount; i++) {
-			markObject((Obj*)closure->upvalues[i]);
+			markValue(closure->upvalues[i]);
 		}
-		break;
+		return 1 + closure->upvalueCount;
 	}
 	case OBJ_BOUND_METHOD: {
 		ObjBoundMethod* bound = (ObjBoundMethod*)object;
 		markValue(bound->receiver);
 		markObject((Obj*)bound->method);
-		break;
+		return 2;
 	}
 		//won't be here
 	//case OBJ_FUNCTION: {
@@ -144,21 +256,79 @@ static void blackenObject(Obj* object) {
 		//markObject((Obj*)klass->name);
 		markValue(klass->initializer);
 		markTable(&klass->methods);
-		break;
+		return 1 + klass->methods.used;
 	}
 	case OBJ_INSTANCE: {
 		ObjInstance* instance = (ObjInstance*)object;
 		ObjClass* klass = instance->klass;
 		if (klass != NULL) {
 			markObject((Obj*)klass);
+			markObject((Obj*)instance->bound);
 			markTable(&instance->fields);
 		}
-		break;
+		return 1 + instance->fields.used;
 	}
 	case OBJ_ARRAY: //only array-any needs gc scan
 		markArrayAny((ObjArray*)object);
-		break;
+		return 1 + ((ObjArray*)object)->length;
+	}
+	return 1;
+}
+
+void rememberObject(Obj* object)
+{
+	if (vm.rememberedCapacity < vm.rememberedCount + 1) {
+		vm.rememberedCapacity = GROW_CAPACITY(vm.rememberedCapacity);
+		vm.rememberedSet = (Obj**)mem_realloc(vm.rememberedSet, sizeof(Obj*) * vm.rememberedCapacity);
+		//same as the gray stack,don't start a gc here
+		if (vm.rememberedSet == NULL) exit(1);//realloc failed
+	}
+
+	object->isRemembered = true;
+	vm.rememberedSet[vm.rememberedCount++] = object;
+}
+
+static void clearRemembered() {
+	for (uint64_t i = 0; i < vm.rememberedCount; ++i) {
+		vm.rememberedSet[i]->isRemembered = false;
+	}
+	vm.rememberedCount = 0;
+}
+
+//the pool is weak,drop the dead strings before the sweep frees them
+static void pruneStrings() {
+	Table* table = &vm.strings;
+
+	for (uint32_t i = 0; i < table->used; i++) {
+		Entry* entry = &table->entries[i];
+		ObjString* key = entry->key;
+		if (key == NULL || key->obj.isStatic) continue;
+
+		if (!IS_BOOL(entry->value) || AS_BOOL(entry->value)) {
+			//pinned,the static objects refer to it
+			heap_setMark((Obj*)key, usingMark);
+		}
+		else if (heap_getMark((Obj*)key) != usingMark) {
+			tableDelete(table, key);
+		}
+	}
+
+	vm.youngStringCount = 0;
+}
+
+//same as above,but a minor gc only frees the young ones
+static void pruneYoungStrings() {
+	for (uint64_t i = 0; i < vm.youngStringCount; ++i) {
+		ObjString* string = vm.youngStrings[i];
+		//pinned after it was made
+		if (string->obj.isOld) continue;
+
+		if (heap_getMark((Obj*)string) != usingMark) {
+			tableDelete(&vm.strings, string);
+		}
 	}
+
+	vm.youngStringCount = 0;
 }
 
 static void traceReferences() {
@@ -168,50 +338,504 @@ static void traceReferences() {
 	}
 }
 
-static void sweep() {
-	Obj* previous = NULL;
-	Obj* object = vm.objects;
+//the sweeping threads count their own bytes
+static inline void releaseBytes(uint64_t bytes) {
+#if GC_THREADS > 1
+	if (gcFreedBytes != NULL) {
+		*gcFreedBytes += bytes;
+		return;
+	}
+#endif
+	vm.bytesAllocated -= bytes;
+}
+
+//free the blocks of the page without the live mark,the young ones stay young
+static uint64_t sweepPage(HeapPage* page, uint8_t liveMark) {
+	uint32_t words = heap_wordCount(page);
+	uint64_t freed = 0;
 
-	while (object != NULL) {
-		if (object->isMarked == usingMark) {
-			//object->isMarked = false;//clear the mark
+	for (uint32_t i = 0; i < words; ++i) {
+		uint64_t marks = page->markBits[i];
+		uint64_t dead = page->allocBits[i] & (liveMark ? ~marks : marks) & heap_validBits(page, i);
+		if (dead == 0) continue;
 
-			previous = object;
-			object = OBJ_PTR_GET_NEXT(object);
+		page->allocBits[i] &= ~dead;
+		for (uint64_t bits = dead; bits != 0; bits &= bits - 1) {
+			freeObject(heap_blockAt(page, (i << 6) + heap_ctz(bits)));
+			++freed;
+		}
+	}
+
+	page->used -= (uint32_t)freed;
+	releaseBytes(freed * page->blockSize);
+	return freed;
+}
+
+#if GC_THREADS > 1
+static int markWorker(void* arg);
+static int freeWorker(void* arg);
+
+//run the worker on workerThreads threads,this one included
+static void runWorkers(thrd_start_t worker) {
+	thrd_t threads[GC_MAX_THREADS];
+	bool started[GC_MAX_THREADS] = { false };
+
+	for (uint32_t i = 1; i < workerThreads; ++i) {
+		started[i] = (thrd_create(&threads[i], worker, (void*)(uintptr_t)i) == thrd_success);
+		if (!started[i]) {
+			//the running markers must not wait for it
+			mtx_lock(&workLock);
+			workerCount--;
+			cnd_broadcast(&workCond);
+			mtx_unlock(&workLock);
+		}
+	}
+
+	worker((void*)(uintptr_t)0);
+
+	for (uint32_t i = 1; i < workerThreads; ++i) {
+		if (started[i]) {
+			thrd_join(threads[i], NULL);
 		}
 		else {
-			Obj* unreached = object;
-			object = OBJ_PTR_GET_NEXT(object);
-			if (previous != NULL) {
-				OBJ_PTR_SET_NEXT(previous, object);
+			//do its share here
+			worker((void*)(uintptr_t)i);
+		}
+	}
+}
+
+//take half of the deque,an idle thief stops being idle before the deque's lock is released
+//so the markers never all look idle while gray objects move between them
+static bool stealWork(WorkDeque* deque, GrayStack* gray, bool idle) {
+	mtx_lock(&deque->lock);
+
+	uint64_t count = deque->gray.count;
+	if (count == 0) {
+		mtx_unlock(&deque->lock);
+		return false;
+	}
+
+	if (idle) {
+		mtx_lock(&workLock);
+		idleWorkers--;
+		mtx_unlock(&workLock);
+	}
+
+	//the oldest ones are nearer the roots and likely lead to more objects
+	uint64_t take = (count + 1) / 2;
+	for (uint64_t i = 0; i < take; ++i) {
+		pushGray(gray, deque->gray.stack[i]);
+	}
+	memmove(deque->gray.stack, deque->gray.stack + take, sizeof(Obj*) * (count - take));
+	deque->gray.count = count - take;
+
+	mtx_unlock(&deque->lock);
+	return true;
+}
+
+//its own deque first,then the others,returns false when all markers are out of work
+static bool findWork(uint32_t index, GrayStack* gray) {
+	for (uint32_t i = 0; i < workerThreads; ++i) {
+		if (stealWork(&workDeques[(index + i) % workerThreads], gray, false)) return true;
+	}
+
+	mtx_lock(&workLock);
+	idleWorkers++;
+
+	while (!markDone) {
+		//an idle marker has an empty deque,so nothing is left anywhere
+		if (idleWorkers == workerCount) {
+			markDone = true;
+			cnd_broadcast(&workCond);
+			break;
+		}
+
+		uint64_t version = workVersion;
+		mtx_unlock(&workLock);
+		for (uint32_t i = 1; i < workerThreads; ++i) {
+			if (stealWork(&workDeques[(index + i) % workerThreads], gray, true)) return true;
+		}
+		mtx_lock(&workLock);
+
+		while (workVersion == version && !markDone && idleWorkers != workerCount) {
+			cnd_wait(&workCond, &workLock);
+		}
+	}
+
+	mtx_unlock(&workLock);
+	return false;
+}
+
+//move half of the gray objects to its deque once the last ones were stolen
+static void offerWork(uint32_t index, GrayStack* gray) {
+	WorkDeque* deque = &workDeques[index];
+	bool offered = false;
+
+	mtx_lock(&deque->lock);
+	if (deque->gray.count == 0) {
+		uint64_t half = gray->count / 2;
+		for (uint64_t i = 0; i < half; ++i) {
+			pushGray(&deque->gray, gray->stack[--gray->count]);
+		}
+		offered = (half > 0);
+	}
+	mtx_unlock(&deque->lock);
+
+	if (offered) {
+		mtx_lock(&workLock);
+		workVersion++;
+		if (idleWorkers > 0) {
+			cnd_broadcast(&workCond);
+		}
+		mtx_unlock(&workLock);
+	}
+}
+
+static int markWorker(void* arg) {
+	uint32_t index = (uint32_t)(uintptr_t)arg;
+	GrayStack gray = { 0, 0, NULL };
+	uint64_t work = 0;
+	workerGray = &gray;
+
+	while (true) {
+		if (gray.count == 0 && !findWork(index, &gray)) break;
+
+		Obj* object = gray.stack[--gray.count];
+		blackenObject(object);
+
+		if ((++work & 255) == 0 && gray.count > 1) {
+			offerWork(index, &gray);
+		}
+	}
+
+	workerGray = NULL;
+	if (gray.stack != NULL) {
+		mem_free(gray.stack);
+	}
+	return 0;
+}
+
+static bool initWorkLocks() {
+	if (mtx_init(&workLock, mtx_plain) != thrd_success) return false;
+	if (cnd_init(&workCond) != thrd_success) return false;
+	for (uint32_t i = 0; i < GC_MAX_THREADS; ++i) {
+		if (mtx_init(&workDeques[i].lock, mtx_plain) != thrd_success) return false;
+	}
+	return true;
+}
+
+static void traceParallel() {
+	//the roots are dealt to the deques,the markers steal from each other from there
+	for (uint64_t i = 0; i < vm.grayCount; ++i) {
+		pushGray(&workDeques[i % workerThreads].gray, vm.grayStack[i]);
+	}
+	vm.grayCount = 0;
+
+	workerCount = workerThreads;
+	idleWorkers = 0;
+	markDone = false;
+	runWorkers(markWorker);
+}
+
+//each worker sweeps a slice of the pages
+static int freeWorker(void* arg) {
+	uint32_t index = (uint32_t)(uintptr_t)arg;
+	uint64_t begin = sweepPageCount * index / workerThreads;
+	uint64_t end = sweepPageCount * (index + 1) / workerThreads;
+	int64_t freed = 0;
+	uint64_t objects = 0;
+	gcFreedBytes = &freed;
+
+	for (uint64_t i = begin; i < end; ++i) {
+		objects += sweepPage(sweepPages[i], usingMark);
+	}
+
+	gcFreedBytes = NULL;
+	mtx_lock(&workLock);
+	vm.bytesAllocated -= freed;
+	freedObjects += objects;
+	mtx_unlock(&workLock);
+	return 0;
+}
+
+static void sweepParallel() {
+	sweepPageCount = 0;
+	for (HeapPage* page = vm.pages; page != NULL; page = page->allNext) {
+		if (sweepPageCapacity < sweepPageCount + 1) {
+			sweepPageCapacity = GROW_CAPACITY(sweepPageCapacity);
+			sweepPages = (HeapPage**)mem_realloc(sweepPages, sizeof(HeapPage*) * sweepPageCapacity);
+			if (sweepPages == NULL) exit(1);//realloc failed
+		}
+		sweepPages[sweepPageCount++] = page;
+	}
+
+	runWorkers(freeWorker);
+
+	//the page lists are not shared
+	for (uint64_t i = 0; i < sweepPageCount; ++i) {
+		heap_updatePage(sweepPages[i]);
+	}
+	sweepPageCount = 0;
+}
+#endif
+
+static void sweep() {
+	HeapPage* page = vm.pages;
+
+	while (page != NULL) {
+		HeapPage* next = page->allNext;
+		freedObjects += sweepPage(page, usingMark);
+		heap_updatePage(page);
+		page = next;
+	}
+}
+
+//free the unmarked young objects and promote the marked ones
+static void sweepYoung(bool resetMark) {
+	HeapPage* page = vm.youngPages;
+	vm.youngPages = NULL;
+
+	while (page != NULL) {
+		HeapPage* next = page->youngNext;
+		uint32_t words = heap_wordCount(page);
+		uint64_t freed = 0;
+
+		for (uint32_t i = 0; i < words; ++i) {
+			uint64_t young = page->youngBits[i];
+			if (young == 0) continue;
+
+			uint64_t marks = page->markBits[i];
+			uint64_t live = young & (usingMark ? marks : ~marks);
+			uint64_t dead = young & ~live;
+
+			for (uint64_t bits = live; bits != 0; bits &= bits - 1) {
+				heap_blockAt(page, (i << 6) + heap_ctz(bits))->isOld = true;
+				++youngSurvivors;
+			}
+			//a minor gc doesn't flip the mark
+			if (resetMark) {
+				page->markBits[i] = usingMark ? (marks & ~live) : (marks | live);
 			}
-			else {
-				vm.objects = object;
+
+			for (uint64_t bits = dead; bits != 0; bits &= bits - 1) {
+				freeObject(heap_blockAt(page, (i << 6) + heap_ctz(bits)));
+				++freed;
 			}
 
-			freeObject(unreached);
+			page->allocBits[i] &= ~dead;
+			page->youngBits[i] = 0;
 		}
+
+		page->used -= (uint32_t)freed;
+		releaseBytes(freed * page->blockSize);
+		freedObjects += freed;
+		page->isYoung = false;
+		heap_updatePage(page);
+		page = next;
+	}
+}
+
+static inline void beginPause() {
+	pauseBegin = timer_nanos();
+}
+
+static inline void endPause() {
+	uint64_t nanos = timer_nanos() - pauseBegin;
+	if (gcPolicy.adaptive) pauseNanos += nanos;
+
+	double seconds = (double)nanos / TIMER_NANOS_PER_SECOND;
+	gcStats.lastPause = seconds;
+	gcStats.totalPause += seconds;
+	if (seconds > gcStats.maxPause) gcStats.maxPause = seconds;
+}
+
+//the blocks in use,the pages count them
+static uint64_t liveObjects() {
+	uint64_t count = 0;
+	for (HeapPage* page = vm.pages; page != NULL; page = page->allNext) {
+		count += page->used;
+	}
+	return count;
+}
+
+static void recordCollection(bool isMajor, uint64_t freedBytes, uint64_t survivors) {
+	if (isMajor) {
+		gcStats.majorCount++;
+	}
+	else {
+		gcStats.minorCount++;
+	}
+	gcStats.freedBytes = freedBytes;
+	gcStats.freedObjects = freedObjects;
+	gcStats.survivors = survivors;
+	gcStats.totalFreedBytes += freedBytes;
+	gcStats.totalFreedObjects += freedObjects;
+}
+
+//grow more when the pauses take much of the time since the last major gc,less when they are cheap
+static double adaptGrowFactor() {
+	if (adaptiveFactor == 0) {
+		adaptiveFactor = gcPolicy.growFactor;
+	}
+
+	uint64_t now = timer_nanos();
+	uint64_t paused = pauseNanos + (now - pauseBegin);
+	uint64_t total = now - cycleBegin;
+
+	//the clock doesn't start with the process,so the first cycle has no length
+	if (cycleBegin != 0 && total > 0) {
+		double percent = (double)paused * 100 / (double)total;
+		if (percent > GC_ADAPTIVE_TARGET) {
+			adaptiveFactor = adaptiveFactor * 1.5;
+		}
+		else if (percent < GC_ADAPTIVE_TARGET / 2.0) {
+			adaptiveFactor = adaptiveFactor / 1.25;
+		}
+		if (adaptiveFactor > GC_ADAPTIVE_MAX_FACTOR) adaptiveFactor = GC_ADAPTIVE_MAX_FACTOR;
+		if (adaptiveFactor < GC_ADAPTIVE_MIN_FACTOR) adaptiveFactor = GC_ADAPTIVE_MIN_FACTOR;
+	}
+
+	//the rest of this pause counts for the next cycle
+	pauseNanos = 0;
+	pauseBegin = now;
+	cycleBegin = now;
+	return adaptiveFactor;
+}
+
+//the factor the last threshold was picked with
+static inline double currentGrowFactor() {
+	return (gcPolicy.adaptive && adaptiveFactor != 0) ? adaptiveFactor : gcPolicy.growFactor;
+}
+
+//the major gc threshold after a cycle that left liveBytes
+static uint64_t nextThreshold(uint64_t liveBytes) {
+	double factor = gcPolicy.adaptive ? adaptGrowFactor() : gcPolicy.growFactor;
+	uint64_t next = max((uint64_t)((double)liveBytes * factor), gcPolicy.heapMin);
+
+	if (gcPolicy.heapMax != 0 && next > gcPolicy.heapMax) {
+		//past the maximum,the heap grows slowly rather than a major gc for every allocation
+		next = max(gcPolicy.heapMax, (uint64_t)((double)liveBytes * GC_ADAPTIVE_MIN_FACTOR) + GC_NURSERY_SIZE);
+	}
+	return next;
+}
+
+void minorCollect()
+{
+#if DEBUG_LOG_GC
+	printf("-- minor gc begin\n");
+#endif
+	beginPause();
+
+	uint64_t before = vm.bytesAllocated;
+	freedObjects = 0;
+	youngSurvivors = 0;
+	isMinorGC = true;
+	markRoots();
+	//old objects that may point to young ones
+	for (uint64_t i = 0; i < vm.rememberedCount; ++i) {
+		blackenObject(vm.rememberedSet[i]);
+	}
+	clearRemembered();
+	traceReferences();
+	pruneYoungStrings();
+	sweepYoung(true);
+	isMinorGC = false;
+
+	vm.nextMinorGC = vm.bytesAllocated + GC_NURSERY_SIZE;
+	recordCollection(false, before - vm.bytesAllocated, youngSurvivors);
+	endPause();
+
+#if DEBUG_LOG_GC
+	printf("-- minor gc end\n");
+#endif
+
+#if DEBUG_LOG_GC || LOG_GC_RESULT
+	printf("[gc] minor collected %zu bytes (from %zu to %zu) next at %zu\n",
+		before - vm.bytesAllocated, before, vm.bytesAllocated, vm.nextMinorGC);
+#endif
+}
+
+static void finishMarking();
+static bool markStep(uint64_t budget, uint64_t deadline);
+static bool sweepStep(uint64_t budget, uint64_t deadline);
+
+//ask the interpreter to compact if the pages are sparse
+static void checkFragmentation() {
+#if GC_COMPACT
+#if DEBUG_STRESS_GC
+	vm.compactPending = true;
+#else
+	if (heap_pageCount() < GC_COMPACT_MIN_PAGES) return;
+
+	uint64_t usedBytes, capacityBytes;
+	heap_occupancy(&usedBytes, &capacityBytes);
+	if (usedBytes * 100 < capacityBytes * GC_COMPACT_OCCUPANCY) {
+		vm.compactPending = true;
 	}
+#endif
+#endif
 }
 
 void garbageCollect()
 {
+	beginPause();
+	//finish the incremental cycle first
+	if (gcPhase == GC_MARKING) {
+		finishMarking();
+	}
+	if (gcPhase == GC_SWEEPING) {
+		sweepStep(UINT64_MAX, 0);
+	}
+
 #if DEBUG_LOG_GC
 	printf("-- gc begin\n");
 #endif
 
-#if DEBUG_LOG_GC || LOG_GC_RESULT
 	uint64_t before = vm.bytesAllocated;
-#endif
+	freedObjects = 0;
+	//everything is old after a full gc
+	clearRemembered();
 	markRoots();
+#if GC_THREADS > 1
+	if (gcPolicy.threads > 1 && !workLockReady) {
+		workLockReady = initWorkLocks();
+	}
+	//the count can't change in the middle of a collection
+	workerThreads = workLockReady ? gcPolicy.threads : 1;
+	if (workerThreads > 1) {
+		traceParallel();
+	}
+	else {
+		traceReferences();
+	}
+	pruneStrings();
+	sweepYoung(false);
+	//the threads sweep the pages
+	if (workerThreads > 1) {
+		sweepParallel();
+	}
+	else {
+		sweep();
+	}
+#else
 	traceReferences();
-	//tableRemoveWhite(&vm.strings);
+	pruneStrings();
+	sweepYoung(false);
 	sweep();
+#endif
 
 	//flip the mark
 	usingMark = !usingMark;
 	//reset the limit
-	vm.nextGC = max(vm.bytesAllocated * GC_HEAP_GROW_FACTOR, gc_heap_begin);
+	vm.nextMinorGC = vm.bytesAllocated + GC_NURSERY_SIZE;
+	//the nursery fills first,or a small heap would never run a minor gc
+	vm.nextGC = max(nextThreshold(vm.bytesAllocated), vm.nextMinorGC);
+#if LARGE_SPACE
+	vm.nextLargeGC = max((uint64_t)((double)large_mappedBytes() * gcPolicy.growFactor), GC_LARGE_BEGIN);
+#endif
+	checkFragmentation();
+	recordCollection(true, before - vm.bytesAllocated, liveObjects());
+	endPause();
 
 #if DEBUG_LOG_GC
 	printf("-- gc end\n");
@@ -223,6 +847,489 @@ void garbageCollect()
 #endif
 }
 
+#if GC_CONCURRENT
+static int markThreadMain(void* arg) {
+	(void)arg;
+
+	while (true) {
+		mtx_lock(&markLock);
+		bool finished = markStep(GC_THREAD_BATCH, 0);
+		if (finished) {
+			markThreadDone = true;
+		}
+		mtx_unlock(&markLock);
+
+		if (finished) return 0;
+	}
+}
+
+void logOverwritten(Obj* object)
+{
+	if (vm.overwrittenCapacity < vm.overwrittenCount + 1) {
+		vm.overwrittenCapacity = GROW_CAPACITY(vm.overwrittenCapacity);
+		vm.overwrittenSet = (Obj**)mem_realloc(vm.overwrittenSet, sizeof(Obj*) * vm.overwrittenCapacity);
+		//same as the gray stack,don't start a gc here
+		if (vm.overwrittenSet == NULL) exit(1);//realloc failed
+	}
+
+	vm.overwrittenSet[vm.overwrittenCount++] = object;
+}
+
+//gray the dropped values,hold the lock if the thread runs
+static void drainOverwritten() {
+	for (uint64_t i = 0; i < vm.overwrittenCount; ++i) {
+		markObject(vm.overwrittenSet[i]);
+	}
+	vm.overwrittenCount = 0;
+}
+
+bool gcLockBuffers()
+{
+	if (!markThreadRunning) return false;
+
+	mtx_lock(&markLock);
+	return true;
+}
+
+void gcUnlockBuffers(bool locked)
+{
+	if (locked) {
+		mtx_unlock(&markLock);
+	}
+}
+
+static void joinMarkThread() {
+	if (markThreadRunning) {
+		thrd_join(markThread, NULL);
+		markThreadRunning = false;
+	}
+}
+#endif
+
+void waitForGC()
+{
+#if GC_CONCURRENT
+	joinMarkThread();
+#endif
+}
+
+#if GC_INCREMENTAL
+//gray all roots,the mutator runs between the steps
+static void startMarking() {
+#if DEBUG_LOG_GC
+	printf("-- incremental gc begin\n");
+#endif
+	gcPhase = GC_MARKING;
+	freedObjects = 0;
+	markRoots();
+
+#if GC_CONCURRENT
+	//the roots are the snapshot,the thread traces it while the mutator runs
+	if (!markLockReady) {
+		markLockReady = (mtx_init(&markLock, mtx_plain) == thrd_success);
+	}
+
+	markThreadDone = false;
+	if (markLockReady && thrd_create(&markThread, markThreadMain, NULL) == thrd_success) {
+		markThreadRunning = true;
+	}
+	else {
+		//no thread,mark it now
+		finishMarking();
+	}
+#endif
+}
+#endif
+
+//the atomic end of marking
+static void finishMarking() {
+#if GC_CONCURRENT
+	//the objects allocated while marking are black,so the roots need no rescan
+	joinMarkThread();
+	drainOverwritten();
+#else
+	//the stack and globals are not guarded by the write barrier,so scan them again
+	markRoots();
+#endif
+	markStep(UINT64_MAX, 0);
+	pruneStrings();
+
+	//the young objects are not swept lazily,promote them now
+	uint64_t before = vm.bytesAllocated;
+	sweepYoung(false);
+	youngFreedBytes = before - vm.bytesAllocated;
+	//everything is old now
+	clearRemembered();
+
+	//flip the mark,the survivors are the ones with the old mark
+	usingMark = !usingMark;
+	gcPhase = GC_SWEEPING;
+	sweepCursor = vm.pages;
+	markedBytes = vm.bytesAllocated;
+	sweptBytes = 0;
+}
+
+static void finishSweeping() {
+	gcPhase = GC_IDLE;
+	sweepCursor = NULL;
+
+	//the young objects allocated while sweeping are not live yet
+	uint64_t liveBytes = markedBytes - sweptBytes;
+	vm.nextMinorGC = vm.bytesAllocated + GC_NURSERY_SIZE;
+	vm.nextGC = max(nextThreshold(liveBytes), vm.nextMinorGC);
+#if LARGE_SPACE
+	vm.nextLargeGC = max((uint64_t)((double)large_mappedBytes() * gcPolicy.growFactor), GC_LARGE_BEGIN);
+#endif
+	checkFragmentation();
+	recordCollection(true, youngFreedBytes + sweptBytes, liveObjects());
+
+#if DEBUG_LOG_GC
+	printf("-- incremental gc end\n");
+#endif
+
+#if DEBUG_LOG_GC || LOG_GC_RESULT
+	printf("[gc] incremental collected %zu bytes (from %zu to %zu) next at %zu\n",
+		sweptBytes, markedBytes, liveBytes, vm.nextGC);
+#endif
+}
+
+//returns true if the budget or the time is used up,check the clock every few objects
+static inline bool stepExpired(uint64_t work, uint64_t budget, uint64_t deadline, uint64_t* clockCheck) {
+	if (work >= budget) return true;
+
+	if (deadline != 0 && work >= *clockCheck) {
+		*clockCheck = work + 64;
+		return timer_nanos() > deadline;
+	}
+	return false;
+}
+
+//the stores into the array are guarded by the write barrier,so it can be scanned across steps
+static uint64_t scanArrayChunk() {
+	uint32_t begin = scanIndex;
+	uint32_t end = scanIndex + GC_ARRAY_CHUNK;
+	if (end >= scanArray->length) {
+		end = scanArray->length;
+	}
+
+	for (uint32_t i = begin; i < end; ++i) {
+		markValue(scanArray->elements[i]);
+	}
+
+	if (end == scanArray->length) {
+		scanArray = NULL;
+	}
+	scanIndex = end;
+
+	return 1 + end - begin;
+}
+
+static bool markStep(uint64_t budget, uint64_t deadline) {
+	uint64_t work = 0;
+	uint64_t clockCheck = 0;
+
+	while (true) {
+		if (scanArray != NULL) {
+			work += scanArrayChunk();
+		}
+		else if (vm.grayCount > 0) {
+			Obj* object = vm.grayStack[--vm.grayCount];
+
+			if (object->type == OBJ_ARRAY && ((ObjArray*)object)->length > GC_ARRAY_CHUNK) {
+				scanArray = (ObjArray*)object;
+				scanIndex = 0;
+				continue;
+			}
+			work += blackenObject(object);
+		}
+		else {
+			return true;
+		}
+
+		if (stepExpired(work, budget, deadline, &clockCheck)) return false;
+	}
+}
+
+//sweep the pages from the cursor,the new pages only have objects allocated since
+static bool sweepStep(uint64_t budget, uint64_t deadline) {
+	uint8_t liveMark = !usingMark;
+	uint64_t work = 0;
+	uint64_t clockCheck = 0;
+
+	while (sweepCursor != NULL) {
+		HeapPage* page = sweepCursor;
+		sweepCursor = page->allNext;
+
+		uint64_t before = vm.bytesAllocated;
+		uint64_t freed = sweepPage(page, liveMark);
+		work += heap_wordCount(page) + freed;
+		freedObjects += freed;
+		heap_updatePage(page);
+		sweptBytes += before - vm.bytesAllocated;
+
+		if (stepExpired(work, budget, deadline, &clockCheck)) return false;
+	}
+
+	finishSweeping();
+	return true;
+}
+
+void incrementalStep()
+{
+	beginPause();
+	//the work is proportional to the allocation since the last step
+	uint64_t allocated = (vm.bytesAllocated > vm.lastGCStep) ? vm.bytesAllocated - vm.lastGCStep : 0;
+	uint64_t budget = max(allocated / sizeof(Value) * GC_STEP_MULTIPLIER, GC_STEP_MIN_WORK);
+	//in wall time,the marking threads don't count
+	uint64_t deadline = (gcPolicy.maxPause != 0) ? timer_nanos() + gcPolicy.maxPause * TIMER_NANOS_PER_MICRO : 0;
+
+	//the mutator allocates faster than the steps,don't limit the time
+	if (vm.bytesAllocated > (uint64_t)((double)vm.nextGC * currentGrowFactor())) {
+		deadline = 0;
+	}
+
+	if (gcPhase == GC_MARKING) {
+#if GC_CONCURRENT
+		//hand the dropped values to the thread,or finish if it has stopped
+		mtx_lock(&markLock);
+		bool finished = markThreadDone;
+		if (!finished) {
+			drainOverwritten();
+		}
+		mtx_unlock(&markLock);
+
+		if (finished) {
+			finishMarking();
+		}
+#else
+		if (markStep(budget, deadline)) {
+			finishMarking();
+		}
+#endif
+	}
+	else if (gcPhase == GC_SWEEPING) {
+		sweepStep(budget, deadline);
+	}
+
+	vm.lastGCStep = vm.bytesAllocated;
+	vm.nextGCStep = vm.bytesAllocated + GC_STEP_SIZE;
+	endPause();
+}
+
+void majorCollect()
+{
+#if GC_INCREMENTAL
+	startMarking();
+	vm.lastGCStep = vm.bytesAllocated;
+	vm.nextGCStep = vm.bytesAllocated + GC_STEP_SIZE;
+#else
+	garbageCollect();
+#endif
+}
+
+#if GC_COMPACT
+static inline Obj* forwardPointer(Obj* object) {
+	if (object == NULL || object->isStatic || !HEAP_PAGE_OF(object)->isEvacuating) return object;
+	return HEAP_FORWARD_SLOT(object);
+}
+
+static inline void forwardValue(Value* value) {
+	if (IS_OBJ(*value)) {
+		value->as.obj = forwardPointer(AS_OBJ(*value));
+	}
+}
+
+static void forwardTable(Table* table) {
+	for (uint32_t i = 0; i < table->used; i++) {
+		Entry* entry = &table->entries[i];
+		//the hash is in the string,so the index stays the same
+		entry->key = (ObjString*)forwardPointer((Obj*)entry->key);
+		forwardValue(&entry->value);
+	}
+}
+
+static void forwardObject(Obj* object) {
+	switch (object->type) {
+	case OBJ_UPVALUE: {
+		ObjUpvalue* upvalue = (ObjUpvalue*)object;
+		forwardValue(&upvalue->closed);
+		upvalue->next = (ObjUpvalue*)forwardPointer((Obj*)upvalue->next);
+		return;
+	}
+	case OBJ_CLOSURE: {
+		ObjClosure* closure = (ObjClosure*)object;
+		for (uint32_t i = 0; i < closure->upvalueCount; i++) {
+			forwardValue(&closure->upvalues[i]);
+		}
+		return;
+	}
+	case OBJ_BOUND_METHOD: {
+		ObjBoundMethod* bound = (ObjBoundMethod*)object;
+		forwardValue(&bound->receiver);
+		bound->method = (ObjClosure*)forwardPointer((Obj*)bound->method);
+		return;
+	}
+	case OBJ_CLASS: {
+		ObjClass* klass = (ObjClass*)object;
+		forwardValue(&klass->initializer);
+		forwardTable(&klass->methods);
+		return;
+	}
+	case OBJ_INSTANCE: {
+		ObjInstance* instance = (ObjInstance*)object;
+		instance->klass = (ObjClass*)forwardPointer((Obj*)instance->klass);
+		instance->bound = (ObjBoundMethod*)forwardPointer((Obj*)instance->bound);
+		forwardTable(&instance->fields);
+		return;
+	}
+	case OBJ_ARRAY: {
+		ObjArray* array = (ObjArray*)object;
+		for (uint32_t i = 0; i < array->length; ++i) {
+			forwardValue(&array->elements[i]);
+		}
+		return;
+	}
+	}
+}
+
+//copy the objects of a page into the free blocks of the others
+static void evacuatePage(HeapPage* page) {
+	for (uint32_t word = 0; word < heap_wordCount(page); ++word) {
+		uint64_t bits = page->allocBits[word] & heap_validBits(page, word);
+
+		while (bits != 0) {
+			uint32_t bit = heap_ctz(bits);
+			bits &= bits - 1;
+
+			uint64_t mask = 1ull << bit;
+			Obj* from = heap_blockAt(page, (word << 6) + bit);
+			Obj* to = heap_allocObject(page->blockSize, (page->youngBits[word] & mask) != 0, heap_getMark(from));
+			memcpy(to, from, page->blockSize);
+
+			//a closed upvalue points at itself
+			if (from->type == OBJ_UPVALUE) {
+				ObjUpvalue* upvalue = (ObjUpvalue*)to;
+				if (upvalue->location == &((ObjUpvalue*)from)->closed) {
+					upvalue->location = &upvalue->closed;
+				}
+			}
+			//so do the inline elements and fields
+			else if (from->type == OBJ_ARRAY) {
+				ObjArray* array = (ObjArray*)to;
+				if (ARRAY_IS_INLINE((ObjArray*)from)) {
+					array->elements = array->inlineElements;
+				}
+			}
+			else if (from->type == OBJ_INSTANCE) {
+				ObjInstance* instance = (ObjInstance*)to;
+				if (instance->fields.entries == INSTANCE_INLINE_ENTRIES(from)) {
+					instance->fields.entries = INSTANCE_INLINE_ENTRIES(instance);
+				}
+			}
+
+			HEAP_FORWARD_SLOT(from) = to;
+		}
+	}
+}
+
+static void forwardRoots() {
+	for (Value* slot = vm.stack; slot < vm.stackTop; slot++) {
+		forwardValue(slot);
+	}
+
+	for (uint32_t i = 0; i < vm.frameCount; i++) {
+		vm.frames[i].closure = (ObjClosure*)forwardPointer((Obj*)vm.frames[i].closure);
+	}
+
+	vm.openUpvalues = (ObjUpvalue*)forwardPointer((Obj*)vm.openUpvalues);
+
+	forwardTable(&vm.strings);
+	for (uint64_t i = 0; i < vm.youngStringCount; ++i) {
+		vm.youngStrings[i] = (ObjString*)forwardPointer((Obj*)vm.youngStrings[i]);
+	}
+
+	forwardTable(&vm.globals.fields);
+	for (uint32_t i = 0; i < BUILTIN_MODULE_COUNT; i++) {
+		forwardTable(&vm.builtins[i].fields);
+	}
+	forwardValue(&vm.emptyClass.initializer);
+	forwardTable(&vm.emptyClass.methods);
+
+	for (uint32_t i = 0; i < vm.constGlobalCount; i++) {
+		forwardValue(&vm.constGlobals[i].value);
+	}
+	for (uint32_t i = 0; i < vm.constants.count; i++) {
+		forwardValue(&vm.constants.values[i]);
+	}
+
+	for (uint64_t i = 0; i < vm.rememberedCount; ++i) {
+		vm.rememberedSet[i] = forwardPointer(vm.rememberedSet[i]);
+	}
+}
+
+COLD_FUNCTION
+void compactHeap()
+{
+	//the marks and the sweep cursor refer to the pages
+	if (gcPhase != GC_IDLE) return;
+	vm.compactPending = false;
+
+#if DEBUG_LOG_GC || LOG_GC_RESULT
+	uint64_t before = heap_pageCount();
+#endif
+
+	uint64_t evacuated = heap_selectEvacuation();
+	if (evacuated == 0) return;
+
+	for (HeapPage* page = vm.pages; page != NULL; page = page->allNext) {
+		if (page->isEvacuating) {
+			evacuatePage(page);
+		}
+	}
+
+	forwardRoots();
+	//the copies are in the other pages too
+	for (HeapPage* page = vm.pages; page != NULL; page = page->allNext) {
+		if (page->isEvacuating) continue;
+
+		for (uint32_t word = 0; word < heap_wordCount(page); ++word) {
+			uint64_t bits = page->allocBits[word] & heap_validBits(page, word);
+
+			while (bits != 0) {
+				uint32_t bit = heap_ctz(bits);
+				bits &= bits - 1;
+				forwardObject(heap_blockAt(page, (word << 6) + bit));
+			}
+		}
+	}
+
+	heap_finishEvacuation();
+
+#if DEBUG_LOG_GC || LOG_GC_RESULT
+	printf("[gc] compacted %zu pages (from %zu to %zu pages)\n",
+		evacuated, before, heap_pageCount());
+#endif
+}
+#endif
+
+#if DEBUG_STRESS_GC
+void stressCollect()
+{
+	static uint32_t collectCount = 0;
+
+	//minor gc on every allocation,and a major one sometimes
+	if (gcPhase != GC_IDLE) {
+		incrementalStep();
+	}
+	else if (++collectCount % 16 == 0) {
+		majorCollect();
+	}
+	else {
+		minorCollect();
+	}
+}
+#endif
+
 void changeNextGC(uint64_t newSize)
 {
 	vm.nextGC = newSize;
@@ -230,5 +1337,269 @@ void changeNextGC(uint64_t newSize)
 
 void changeBeginGC(uint64_t newSize)
 {
-	gc_heap_begin = newSize;
+	gcPolicy.heapMin = newSize;
+}
+
+bool parseSize(C_STR value, uint64_t* size)
+{
+	char* end;
+	double number = strtod(value, &end);
+	if (end == value || !(number >= 0)) return false;
+
+	switch (*end) {
+	case 'k': case 'K': number *= 1024; ++end; break;
+	case 'm': case 'M': number *= 1024 * 1024; ++end; break;
+	case 'g': case 'G': number *= 1024 * 1024 * 1024; ++end; break;
+	}
+	if (*end == 'b' || *end == 'B') ++end;
+	if (*end != '\0' || number >= 18446744073709551616.0) return false;
+
+	*size = (uint64_t)number;
+	return true;
+}
+
+static bool parseSwitch(C_STR value, bool* on) {
+	if (strcmp(value, "1") == 0 || strcmp(value, "on") == 0 || strcmp(value, "true") == 0) {
+		*on = true;
+		return true;
+	}
+	if (strcmp(value, "0") == 0 || strcmp(value, "off") == 0 || strcmp(value, "false") == 0) {
+		*on = false;
+		return true;
+	}
+	return false;
+}
+
+bool setGrowFactor(double factor)
+{
+	//the heap has to grow after a collection
+	if (!(factor > 1) || factor > GC_ADAPTIVE_MAX_FACTOR * 8) return false;
+	gcPolicy.growFactor = factor;
+	return true;
+}
+
+bool setGCThreads(double count)
+{
+#if GC_THREADS > 1
+	if (!(count >= 1) || count > GC_MAX_THREADS || count != (uint32_t)count) return false;
+#else
+	//the parallel gc isn't compiled
+	if (count != 1) return false;
+#endif
+	gcPolicy.threads = (uint32_t)count;
+	return true;
+}
+
+bool setGCOption(C_STR name, C_STR value)
+{
+	if (strcmp(name, "heap-begin") == 0) return parseSize(value, &gcPolicy.heapBegin);
+	if (strcmp(name, "heap-min") == 0) return parseSize(value, &gcPolicy.heapMin);
+	if (strcmp(name, "heap-max") == 0) return parseSize(value, &gcPolicy.heapMax);
+	if (strcmp(name, "heap-limit") == 0) return parseSize(value, &gcPolicy.heapLimit);
+	if (strcmp(name, "adaptive") == 0) return parseSwitch(value, &gcPolicy.adaptive);
+	if (strcmp(name, "max-pause") == 0) {
+		char* end;
+		unsigned long long micros = strtoull(value, &end, 10);
+		if (end == value || *end != '\0' || value[0] == '-') return false;
+		gcPolicy.maxPause = (uint64_t)micros;
+		return true;
+	}
+	if (strcmp(name, "grow") == 0) {
+		char* end;
+		double factor = strtod(value, &end);
+		if (end == value || *end != '\0') return false;
+		return setGrowFactor(factor);
+	}
+	if (strcmp(name, "threads") == 0) {
+		char* end;
+		double count = strtod(value, &end);
+		if (end == value || *end != '\0') return false;
+		return setGCThreads(count);
+	}
+	return false;
+}
+
+COLD_FUNCTION
+bool loadGCEnvironment()
+{
+	static const struct {
+		C_STR variable;
+		C_STR option;
+	} variables[] = {
+		{ "FLITE_GC_HEAP_BEGIN", "heap-begin" },
+		{ "FLITE_GC_HEAP_MIN", "heap-min" },
+		{ "FLITE_GC_HEAP_MAX", "heap-max" },
+		{ "FLITE_GC_HEAP_LIMIT", "heap-limit" },
+		{ "FLITE_GC_GROW", "grow" },
+		{ "FLITE_GC_ADAPTIVE", "adaptive" },
+		{ "FLITE_GC_MAX_PAUSE", "max-pause" },
+		{ "FLITE_GC_THREADS", "threads" },
+	};
+
+	for (uint32_t i = 0; i < sizeof(variables) / sizeof(variables[0]); ++i) {
+		C_STR value = getenv(variables[i].variable);
+		if (value != NULL && !setGCOption(variables[i].option, value)) {
+			fprintf(stderr, "Invalid value \"%s\" of %s.\n", value, variables[i].variable);
+			return false;
+		}
+	}
+	return true;
+}
+
+static inline uint64_t limitedBytes() {
+#if LARGE_SPACE
+	return vm.bytesAllocated + large_mappedBytes();
+#else
+	return vm.bytesAllocated;
+#endif
+}
+
+//the collections in a row that left the heap just under the limit
+static uint32_t tightCollections = 0;
+
+bool checkHeapLimit(uint64_t pending)
+{
+	//the interpreter reports it at the next call or safe point
+	if (vm.heapExhausted) return false;
+	if (limitedBytes() + pending <= gcPolicy.heapLimit) return true;
+
+	//the last chance before the error
+	garbageCollect();
+	uint64_t needed = limitedBytes() + pending;
+	if (needed > gcPolicy.heapLimit) {
+		tightCollections = 0;
+		vm.heapExhausted = true;
+		return false;
+	}
+
+	//the live objects fill the limit,each full gc only buys a few allocations
+	if (gcPolicy.heapLimit - needed < gcPolicy.heapLimit / GC_LIMIT_HEADROOM) {
+		if (++tightCollections >= GC_LIMIT_RETRIES) {
+			tightCollections = 0;
+			vm.heapExhausted = true;
+			return false;
+		}
+	}
+	else {
+		tightCollections = 0;
+	}
+	return true;
+}
+
+static inline uint64_t tableBuffer(Table* table) {
+	return (table->type == TABLE_INLINE) ? 0 : TABLE_STORAGE_SIZE(table->capacity);
+}
+
+uint64_t objectBytes(Obj* object)
+{
+	if (!object->isStatic) {
+		return HEAP_PAGE_OF(object)->blockSize;
+	}
+
+	switch (object->type) {
+	case OBJ_STRING:
+		return sizeof(ObjString) + ((ObjString*)object)->length + 1;
+	case OBJ_FUNCTION:
+		return sizeof(ObjFunction);
+	case OBJ_NATIVE:
+		return sizeof(ObjNative);
+	default:
+		return 0;
+	}
+}
+
+uint64_t objectBufferBytes(Obj* object)
+{
+	switch (object->type) {
+	case OBJ_CLASS:
+		return tableBuffer(&((ObjClass*)object)->methods);
+	case OBJ_INSTANCE:
+		return tableBuffer(&((ObjInstance*)object)->fields);
+	case OBJ_ARRAY: {
+		ObjArray* array = (ObjArray*)object;
+		return ARRAY_IS_INLINE(array) ? 0 : (uint64_t)array->capacity * sizeof(Value);
+	}
+	case OBJ_FUNCTION: {
+		ObjFunction* function = (ObjFunction*)object;
+		uint64_t bytes = function->chunk.capacity;
+		if (function->lazy != NULL) {
+			bytes += sizeof(LazyBody) + function->lazy->length + 1;
+		}
+		return bytes;
+	}
+	default:
+		return 0;
+	}
+}
+
+static inline void countObject(TypeStats stats[OBJ_TYPE_COUNT], Obj* object) {
+	TypeStats* type = &stats[object->type];
+	type->count++;
+	type->bytes += objectBytes(object);
+	type->bufferBytes += objectBufferBytes(object);
+}
+
+COLD_FUNCTION
+void collectTypeStats(TypeStats stats[OBJ_TYPE_COUNT])
+{
+	//the marking thread may be running
+	waitForGC();
+	memset(stats, 0, sizeof(TypeStats) * OBJ_TYPE_COUNT);
+
+	for (HeapPage* page = vm.pages; page != NULL; page = page->allNext) {
+		uint32_t words = heap_wordCount(page);
+
+		for (uint32_t i = 0; i < words; ++i) {
+			uint64_t bits = page->allocBits[i] & heap_validBits(page, i);
+
+			for (; bits != 0; bits &= bits - 1) {
+				countObject(stats, heap_blockAt(page, (i << 6) + heap_ctz(bits)));
+			}
+		}
+	}
+
+	for (uint64_t i = 0; i < vm.staticCount; ++i) {
+		countObject(stats, vm.staticObjects[i]);
+	}
+}
+
+COLD_FUNCTION
+void dumpHeapStats(C_STR path)
+{
+	FILE* file = (strcmp(path, "-") == 0) ? stderr : fopen(path, "w");
+	if (file == NULL) {
+		fprintf(stderr, "Could not open file \"%s\".\n", path);
+		return;
+	}
+
+	TypeStats stats[OBJ_TYPE_COUNT];
+	collectTypeStats(stats);
+
+	fprintf(file, "{\"types\":{");
+	for (uint32_t i = 0; i < OBJ_TYPE_COUNT; ++i) {
+		fprintf(file, "%s\"%s\":{\"count\":%llu,\"bytes\":%llu,\"buffers\":%llu}", (i == 0) ? "" : ",", objTypeInfo[i],
+			(unsigned long long)stats[i].count, (unsigned long long)stats[i].bytes, (unsigned long long)stats[i].bufferBytes);
+	}
+
+	fprintf(file, "},\"gc\":{\"minor\":%llu,\"major\":%llu,\"lastPause\":%.6f,\"maxPause\":%.6f,\"totalPause\":%.6f,"
+		"\"freedBytes\":%llu,\"freedObjects\":%llu,\"survivors\":%llu,\"totalFreedBytes\":%llu,\"totalFreedObjects\":%llu}",
+		(unsigned long long)gcStats.minorCount, (unsigned long long)gcStats.majorCount,
+		gcStats.lastPause, gcStats.maxPause, gcStats.totalPause,
+		(unsigned long long)gcStats.freedBytes, (unsigned long long)gcStats.freedObjects, (unsigned long long)gcStats.survivors,
+		(unsigned long long)gcStats.totalFreedBytes, (unsigned long long)gcStats.totalFreedObjects);
+
+	uint64_t usedBytes, capacityBytes;
+	heap_occupancy(&usedBytes, &capacityBytes);
+#if LARGE_SPACE
+	uint64_t largeBytes = large_mappedBytes();
+#else
+	uint64_t largeBytes = 0;
+#endif
+	fprintf(file, ",\"heap\":{\"allocated\":%llu,\"used\":%llu,\"capacity\":%llu,\"pages\":%llu,\"large\":%llu}}\n",
+		(unsigned long long)vm.bytesAllocated, (unsigned long long)usedBytes, (unsigned long long)capacityBytes,
+		(unsigned long long)heap_pageCount(), (unsigned long long)largeBytes);
+
+	if (file != stderr) {
+		fclose(file);
+	}
 }
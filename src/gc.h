@@ -6,15 +6,205 @@
 #pragma once
 #include "common.h"
 #include "value.h"
+#include "object.h"
 
 #define GC_HEAP_GROW_FACTOR 2
 #define GC_HEAP_BEGIN 1024 * 1024
+//bytes allocated between minor collections
+#define GC_NURSERY_SIZE 1024 * 1024
+//mapped bytes of large buffers before the first major collection they trigger
+#define GC_LARGE_BEGIN 64 * 1024 * 1024
+//bytes allocated between incremental steps
+#define GC_STEP_SIZE 64 * 1024
+//work of a step for each allocated Value-sized slot
+#define GC_STEP_MULTIPLIER 8
+//at least some progress for each step
+#define GC_STEP_MIN_WORK 64
+//large arrays are scanned in chunks by the steps
+#define GC_ARRAY_CHUNK 4096
+//work of the marking thread between two unlocks
+#define GC_THREAD_BATCH 1024
+//the most threads --gc-threads can ask for
+#define GC_MAX_THREADS 64
+//the heap must have this many pages to be compacted
+#define GC_COMPACT_MIN_PAGES 16
+//compact when the live blocks fill less than this percent of the pages
+#define GC_COMPACT_OCCUPANCY 50
+//the adaptive policy keeps the gc pauses near this percent of the run time
+#define GC_ADAPTIVE_TARGET 5
+//the range of the grow factor it picks
+#define GC_ADAPTIVE_MIN_FACTOR 1.25
+#define GC_ADAPTIVE_MAX_FACTOR 8.0
+//a collection for the heap limit that leaves less than 1/16 of it free barely helps
+#define GC_LIMIT_HEADROOM 16
+//so many of them in a row and the heap is exhausted,or a heap just under the limit runs a full gc every few allocations
+#define GC_LIMIT_RETRIES 4
+
+//set before vm_init by the command line and the environment,the @sys natives change it later
+typedef struct {
+	//the first major gc threshold
+	uint64_t heapBegin;
+	//the threshold is never lower
+	uint64_t heapMin;
+	//the threshold is never higher,0 is unbounded
+	uint64_t heapMax;
+	//a runtime error if a full gc can't get under it,0 is none
+	uint64_t heapLimit;
+	//the next threshold is the live bytes times it
+	double growFactor;
+	//pick the grow factor from the time spent in the gc
+	bool adaptive;
+	//the longest incremental step in microseconds,0 only limits the work
+	uint64_t maxPause;
+	//the threads of a full collection,more than 1 only with GC_THREADS > 1
+	uint32_t threads;
+} GCPolicy;
+
+//the objects of one type,found by walking the heap
+typedef struct {
+	uint64_t count;
+	//the blocks,or the allocations of the static objects
+	uint64_t bytes;
+	//the tables,elements and code outside of them
+	uint64_t bufferBytes;
+} TypeStats;
+
+//since the vm started
+typedef struct {
+	uint64_t minorCount;
+	uint64_t majorCount;
+	//in seconds,an incremental step is a pause too
+	double lastPause;
+	double maxPause;
+	double totalPause;
+	//of the last collection
+	uint64_t freedBytes;
+	uint64_t freedObjects;
+	uint64_t survivors;
+	uint64_t totalFreedBytes;
+	uint64_t totalFreedObjects;
+} GCStats;
+
+typedef enum {
+	GC_IDLE,
+	GC_MARKING,
+	GC_SWEEPING,
+} GCPhase;
 
 //please don't modify them from outside
 extern uint8_t usingMark;
+extern uint8_t gcPhase;
+extern GCPolicy gcPolicy;
+extern GCStats gcStats;
+#if GC_THREADS > 1
+//the bytes freed by a sweeping thread,NULL on the mutator
+extern _Thread_local int64_t* gcFreedBytes;
+#endif
 
 void markObject(Obj* object);
 void markValue(Value value);
+void rememberObject(Obj* object);
 void garbageCollect();
+void majorCollect();
+void minorCollect();
+void incrementalStep();
+void waitForGC();
+#if GC_COMPACT
+//only call it at a safe point of the interpreter,no object pointer may be held in c locals
+void compactHeap();
+#endif
+#if GC_CONCURRENT
+void logOverwritten(Obj* object);
+bool gcLockBuffers();
+void gcUnlockBuffers(bool locked);
+#else
+#define gcLockBuffers() false
+#define gcUnlockBuffers(locked) ((void)(locked))
+#endif
+#if DEBUG_STRESS_GC
+void stressCollect();
+#endif
 void changeNextGC(uint64_t newSize);
-void changeBeginGC(uint64_t newSize);
\ No newline at end of file
+void changeBeginGC(uint64_t newSize);
+//a byte count like 4096,64K,16M or 1G
+bool parseSize(C_STR value, uint64_t* size);
+//above 1 and at most GC_ADAPTIVE_MAX_FACTOR * 8,returns false and keeps the old one otherwise
+bool setGrowFactor(double factor);
+//1 to GC_MAX_THREADS,or only 1 without GC_THREADS > 1,returns false and keeps the old one otherwise
+bool setGCThreads(double count);
+//name is like "heap-limit",sizes take a K,M or G suffix,returns false for a bad name or value
+bool setGCOption(C_STR name, C_STR value);
+//read the FLITE_GC_* variables,returns false for a bad value
+bool loadGCEnvironment();
+//the heap limit applies to the gc heap and the large buffers,pending is about to be allocated
+//returns false and flags vm.heapExhausted if it doesn't fit even after a collection,
+//or if GC_LIMIT_RETRIES collections in a row could only leave a sliver of the limit free
+bool checkHeapLimit(uint64_t pending);
+//the block of a heap object,or the allocation of a static one
+uint64_t objectBytes(Obj* object);
+//the tables,elements and code it owns outside of the block
+uint64_t objectBufferBytes(Obj* object);
+//indexed by ObjType,the static objects are counted too
+void collectTypeStats(TypeStats stats[OBJ_TYPE_COUNT]);
+//one json line with the types,the collections and the heap,"-" is stderr
+void dumpHeapStats(C_STR path);
+
+//call it after an object stores a value
+static inline void writeBarrier(Obj* object, Value value) {
+	if (IS_OBJ(value)) {
+		Obj* target = AS_OBJ(value);
+		//the minor gc has to scan the old object if the value is young
+		if (object->isOld && !object->isRemembered && !target->isOld) {
+			rememberObject(object);
+		}
+#if GC_INCREMENTAL && !GC_CONCURRENT
+		//the object may be black already,so shade the value
+		if (gcPhase == GC_MARKING) {
+			markObject(target);
+		}
+#endif
+	}
+}
+
+//call it before an object drops a value,the marking thread has to see every object of the snapshot
+static inline void overwriteBarrier(Value old) {
+#if GC_CONCURRENT
+	if (gcPhase == GC_MARKING && IS_OBJ(old)) {
+		logOverwritten(AS_OBJ(old));
+	}
+#endif
+}
+
+//store a value into an object the marking thread may be tracing,a value is two words and must not be read half written
+static inline void storeValue(Value* slot, Value value) {
+#if GC_CONCURRENT
+	bool locked = gcLockBuffers();
+	*slot = value;
+	gcUnlockBuffers(locked);
+#else
+	*slot = value;
+#endif
+}
+
+//call it when a weak table hands out an object,it may be white while marking
+static inline void weakReadBarrier(Obj* object) {
+#if GC_INCREMENTAL
+	if (gcPhase == GC_MARKING && !object->isStatic) {
+#if GC_CONCURRENT
+		logOverwritten(object);
+#else
+		markObject(object);
+#endif
+	}
+#endif
+}
+
+//same as above,for the value of a key in a table
+static inline void tableOverwriteBarrier(Table* table, ObjString* key) {
+#if GC_CONCURRENT
+	Value old;
+	if (gcPhase == GC_MARKING && tableGet(table, key, &old)) {
+		overwriteBarrier(old);
+	}
+#endif
+}
\ No newline at end of file
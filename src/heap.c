@@ -0,0 +1,410 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#include "heap.h"
+#include "slab.h"
+#include "vm.h"
+
+#if HEAP_PAGE_SIZE != SLAB_PAGE_SIZE
+#error "the heap pages are mapped by the slab allocator"
+#endif
+
+#define HEAP_HEADER_SIZE ((sizeof(HeapPage) + 63) & ~(uint64_t)63)
+
+static HeapPage* available[HEAP_CLASS_COUNT];
+static HeapPage* emptyPages = NULL;
+static uint32_t emptyCount = 0;
+static uint64_t pageCount = 0;
+
+static inline void linkAvailable(HeapPage* page) {
+	HeapPage** head = &available[page->classIndex];
+	page->prev = NULL;
+	page->next = *head;
+	if (*head != NULL) {
+		(*head)->prev = page;
+	}
+	*head = page;
+	page->isAvailable = true;
+}
+
+static inline void unlinkAvailable(HeapPage* page) {
+	if (page->prev != NULL) {
+		page->prev->next = page->next;
+	}
+	else {
+		available[page->classIndex] = page->next;
+	}
+	if (page->next != NULL) {
+		page->next->prev = page->prev;
+	}
+	page->isAvailable = false;
+}
+
+static inline void linkPage(HeapPage* page) {
+	page->allPrev = NULL;
+	page->allNext = vm.pages;
+	if (vm.pages != NULL) {
+		vm.pages->allPrev = page;
+	}
+	vm.pages = page;
+}
+
+static void clearBitmaps(HeapPage* page) {
+	memset(page->allocBits, 0, sizeof(page->allocBits));
+	memset(page->markBits, 0, sizeof(page->markBits));
+	memset(page->youngBits, 0, sizeof(page->youngBits));
+	for (uint32_t i = page->capacity; i < HEAP_BITMAP_WORDS * 64; ++i) {
+		page->allocBits[i >> 6] |= 1ull << (i & 63);
+	}
+}
+
+COLD_FUNCTION
+static HeapPage* newPage(uint32_t classIndex) {
+	HeapPage* page = emptyPages;
+
+	if (page != NULL) {
+		emptyPages = page->next;
+		emptyCount--;
+	}
+	else {
+		page = (HeapPage*)slab_mapPage();
+		if (page == NULL) {
+			fprintf(stderr, "Memory reallocation failed!\n");
+			exit(1);
+		}
+		pageCount++;
+	}
+
+	uint32_t blockSize = (classIndex + 1) * HEAP_GRANULE;
+	page->blocks = (char*)page + HEAP_HEADER_SIZE;
+	page->blockSize = blockSize;
+	page->divisor = (uint32_t)(((1ull << 32) + blockSize - 1) / blockSize);
+	page->capacity = (uint32_t)((HEAP_PAGE_SIZE - HEAP_HEADER_SIZE) / blockSize);
+	page->used = 0;
+	page->classIndex = classIndex;
+	page->freeHint = 0;
+	page->span = 1;
+	page->pinned = 0;
+	page->isYoung = false;
+	page->isEvacuating = false;
+	page->isLarge = false;
+
+	clearBitmaps(page);
+	linkPage(page);
+	linkAvailable(page);
+	return page;
+}
+
+COLD_FUNCTION
+static HeapPage* newLargePage(uint64_t size) {
+	uint64_t span = (HEAP_HEADER_SIZE + size + HEAP_PAGE_SIZE - 1) / HEAP_PAGE_SIZE;
+	HeapPage* page = (HeapPage*)slab_mapPages(span);
+	if (page == NULL) {
+		fprintf(stderr, "Memory reallocation failed!\n");
+		exit(1);
+	}
+	pageCount += span;
+
+	page->blocks = (char*)page + HEAP_HEADER_SIZE;
+	page->blockSize = (uint32_t)size;
+	//the only block is at index 0
+	page->divisor = 0;
+	page->capacity = 1;
+	page->used = 0;
+	page->classIndex = HEAP_LARGE_CLASS;
+	page->freeHint = 0;
+	page->span = (uint32_t)span;
+	page->pinned = 0;
+	page->isAvailable = false;
+	page->isYoung = false;
+	page->isEvacuating = false;
+	page->isLarge = true;
+
+	clearBitmaps(page);
+	linkPage(page);
+	return page;
+}
+
+static void retirePage(HeapPage* page) {
+	if (page->isAvailable) {
+		unlinkAvailable(page);
+	}
+
+	if (page->allPrev != NULL) {
+		page->allPrev->allNext = page->allNext;
+	}
+	else {
+		vm.pages = page->allNext;
+	}
+	if (page->allNext != NULL) {
+		page->allNext->allPrev = page->allPrev;
+	}
+
+	if (page->isLarge) {
+		pageCount -= page->span;
+		slab_unmapPages(page, page->span);
+	}
+	else if (emptyCount < HEAP_KEEP_PAGES) {
+		page->next = emptyPages;
+		emptyPages = page;
+		emptyCount++;
+	}
+	else {
+		slab_unmapPage(page);
+		pageCount--;
+	}
+}
+
+void heap_init()
+{
+	for (uint32_t i = 0; i < HEAP_CLASS_COUNT; ++i) {
+		available[i] = NULL;
+	}
+	emptyPages = NULL;
+	emptyCount = 0;
+	pageCount = 0;
+
+	vm.pages = NULL;
+	vm.youngPages = NULL;
+}
+
+void heap_free()
+{
+	while (vm.pages != NULL) {
+		HeapPage* page = vm.pages;
+		vm.pages = page->allNext;
+		pageCount -= page->span;
+		slab_unmapPages(page, page->span);
+	}
+
+	while (emptyPages != NULL) {
+		HeapPage* page = emptyPages;
+		emptyPages = page->next;
+		slab_unmapPage(page);
+		pageCount--;
+	}
+	emptyCount = 0;
+
+	for (uint32_t i = 0; i < HEAP_CLASS_COUNT; ++i) {
+		available[i] = NULL;
+	}
+	vm.youngPages = NULL;
+}
+
+static inline void setBits(HeapPage* page, uint32_t word, uint64_t mask, bool young, uint8_t mark) {
+	page->allocBits[word] |= mask;
+
+#if HEAP_ATOMIC_MARK
+	if (mark) {
+		ATOMIC_OR_U64(&page->markBits[word], mask);
+	}
+	else {
+		ATOMIC_AND_U64(&page->markBits[word], ~mask);
+	}
+#else
+	page->markBits[word] = mark ? (page->markBits[word] | mask) : (page->markBits[word] & ~mask);
+#endif
+
+	if (young) {
+		page->youngBits[word] |= mask;
+		if (!page->isYoung) {
+			page->isYoung = true;
+			page->youngNext = vm.youngPages;
+			vm.youngPages = page;
+		}
+	}
+}
+
+COLD_FUNCTION
+static Obj* allocLarge(uint64_t size, bool young, uint8_t mark) {
+	HeapPage* page = newLargePage(HEAP_BLOCK_SIZE(size));
+	setBits(page, 0, 1, young, mark);
+	page->used = 1;
+	return heap_blockAt(page, 0);
+}
+
+HOT_FUNCTION
+Obj* heap_allocObject(uint64_t size, bool young, uint8_t mark)
+{
+	if (size > HEAP_MAX_SIZE) {
+		return allocLarge(size, young, mark);
+	}
+
+	uint32_t classIndex = (uint32_t)(HEAP_BLOCK_SIZE(size) / HEAP_GRANULE) - 1;
+	HeapPage* page = available[classIndex];
+
+	if (page == NULL) {
+		page = newPage(classIndex);
+	}
+
+	//the page isn't full,so there is a free bit
+	uint32_t word = page->freeHint;
+	while (page->allocBits[word] == UINT64_MAX) {
+		++word;
+	}
+	page->freeHint = word;
+
+	uint32_t bit = heap_ctz(~page->allocBits[word]);
+	setBits(page, word, 1ull << bit, young, mark);
+
+	//full pages leave the list until a block is swept
+	if (++page->used == page->capacity) {
+		unlinkAvailable(page);
+	}
+
+	return heap_blockAt(page, (word << 6) + bit);
+}
+
+void heap_updatePage(HeapPage* page)
+{
+	page->freeHint = 0;
+
+	if (page->used == 0 && !page->isYoung) {
+		retirePage(page);
+	}
+	else if (page->used < page->capacity && !page->isAvailable && !page->isLarge) {
+		linkAvailable(page);
+	}
+}
+
+void heap_freeObject(Obj* object)
+{
+	HeapPage* page = HEAP_PAGE_OF(object);
+	uint32_t index = heap_blockIndex(page, object);
+	uint32_t word = index >> 6;
+	uint64_t mask = 1ull << (index & 63);
+
+	page->allocBits[word] &= ~mask;
+	page->youngBits[word] &= ~mask;
+	page->used--;
+
+	//the sweep may be walking the pages,so the empty one waits for it to be retired
+	if (word < page->freeHint) {
+		page->freeHint = word;
+	}
+	if (!page->isAvailable && !page->isLarge) {
+		linkAvailable(page);
+	}
+}
+
+void heap_pin(Obj* object)
+{
+	HeapPage* page = HEAP_PAGE_OF(object);
+	uint32_t index = heap_blockIndex(page, object);
+
+	//a pinned object lives as long as the vm,the minor gc has nothing to do with it
+	page->youngBits[index >> 6] &= ~(1ull << (index & 63));
+	page->pinned++;
+}
+
+uint64_t heap_pageCount()
+{
+	return pageCount;
+}
+
+void heap_occupancy(uint64_t* usedBytes, uint64_t* capacityBytes)
+{
+	*usedBytes = 0;
+	*capacityBytes = 0;
+
+	for (HeapPage* page = vm.pages; page != NULL; page = page->allNext) {
+		*usedBytes += (uint64_t)page->used * page->blockSize;
+		*capacityBytes += (uint64_t)page->capacity * page->blockSize;
+	}
+}
+
+//by class,then the sparse pages first
+static int comparePages(const void* a, const void* b) {
+	HeapPage* pageA = *(HeapPage* const*)a;
+	HeapPage* pageB = *(HeapPage* const*)b;
+
+	if (pageA->classIndex != pageB->classIndex) {
+		return (pageA->classIndex < pageB->classIndex) ? -1 : 1;
+	}
+	if (pageA->used != pageB->used) {
+		return (pageA->used < pageB->used) ? -1 : 1;
+	}
+	return 0;
+}
+
+COLD_FUNCTION
+uint64_t heap_selectEvacuation()
+{
+	uint64_t count = 0;
+	for (HeapPage* page = vm.pages; page != NULL; page = page->allNext) {
+		if (!page->isLarge) ++count;
+	}
+	if (count < 2) return 0;
+
+	HeapPage** pages = (HeapPage**)mem_alloc(sizeof(HeapPage*) * count);
+	if (pages == NULL) return 0;
+
+	count = 0;
+	for (HeapPage* page = vm.pages; page != NULL; page = page->allNext) {
+		if (!page->isLarge) pages[count++] = page;
+	}
+	qsort(pages, count, sizeof(HeapPage*), comparePages);
+
+	uint64_t selected = 0;
+	uint64_t begin = 0;
+	while (begin < count) {
+		uint32_t classIndex = pages[begin]->classIndex;
+		uint64_t end = begin;
+		uint64_t spare = 0;
+
+		while (end < count && pages[end]->classIndex == classIndex) {
+			spare += pages[end]->capacity - pages[end]->used;
+			++end;
+		}
+
+		//a page leaves with its own free blocks,and its objects take some of the rest
+		for (uint64_t i = begin; i < end; ++i) {
+			HeapPage* page = pages[i];
+			if (page->pinned > 0) continue;
+			if (spare < page->capacity) break;
+
+			spare -= page->capacity;
+			page->isEvacuating = true;
+			if (page->isAvailable) {
+				unlinkAvailable(page);
+			}
+			++selected;
+		}
+
+		begin = end;
+	}
+
+	mem_free(pages);
+	return selected;
+}
+
+COLD_FUNCTION
+void heap_finishEvacuation()
+{
+	HeapPage** link = &vm.youngPages;
+	while (*link != NULL) {
+		if ((*link)->isEvacuating) {
+			(*link)->isYoung = false;
+			*link = (*link)->youngNext;
+		}
+		else {
+			link = &(*link)->youngNext;
+		}
+	}
+
+	HeapPage* page = vm.pages;
+	while (page != NULL) {
+		HeapPage* next = page->allNext;
+
+		if (page->isEvacuating) {
+			clearBitmaps(page);
+			page->used = 0;
+			page->isEvacuating = false;
+			retirePage(page);
+		}
+
+		page = next;
+	}
+}
\ No newline at end of file
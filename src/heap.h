@@ -0,0 +1,168 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#pragma once
+#include "common.h"
+#include "value.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//the gc objects of one size class share an aligned page
+#define HEAP_PAGE_SIZE (64 * 1024)
+//the size classes are multiples of it
+#define HEAP_GRANULE 8
+//the bitmaps have a bit for each block of this size
+#define HEAP_MIN_BLOCK 16
+//a closure with 255 upvalues fits
+#define HEAP_MAX_SIZE 4096
+#define HEAP_CLASS_COUNT (HEAP_MAX_SIZE / HEAP_GRANULE)
+#define HEAP_BITMAP_WORDS (HEAP_PAGE_SIZE / HEAP_MIN_BLOCK / 64)
+//empty pages kept for reuse,the others go back to the os
+#define HEAP_KEEP_PAGES 8
+
+//a larger object gets pages of its own,the class index of them
+#define HEAP_LARGE_CLASS HEAP_CLASS_COUNT
+
+#define HEAP_BLOCK_SIZE(size) \
+	(((size) < HEAP_MIN_BLOCK) ? HEAP_MIN_BLOCK : (((size) + HEAP_GRANULE - 1) & ~(uint64_t)(HEAP_GRANULE - 1)))
+
+//another thread sets mark bits in the same words
+#if GC_CONCURRENT || GC_THREADS > 1
+#define HEAP_ATOMIC_MARK 1
+#else
+#define HEAP_ATOMIC_MARK 0
+#endif
+
+#if defined(_MSC_VER)
+#define ATOMIC_OR_U64(ptr, value) ((uint64_t)_InterlockedOr64((volatile long long*)(ptr), (long long)(value)))
+#define ATOMIC_AND_U64(ptr, value) ((uint64_t)_InterlockedAnd64((volatile long long*)(ptr), (long long)(value)))
+#define ATOMIC_LOAD_U64(ptr) (*(volatile uint64_t*)(ptr))
+#else
+#define ATOMIC_OR_U64(ptr, value) __atomic_fetch_or((ptr), (value), __ATOMIC_RELAXED)
+#define ATOMIC_AND_U64(ptr, value) __atomic_fetch_and((ptr), (value), __ATOMIC_RELAXED)
+#define ATOMIC_LOAD_U64(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#endif
+
+typedef struct HeapPage {
+	//the pages of a class with free blocks
+	struct HeapPage* prev;
+	struct HeapPage* next;
+	//all pages
+	struct HeapPage* allPrev;
+	struct HeapPage* allNext;
+	//the pages with young objects
+	struct HeapPage* youngNext;
+	char* blocks;
+	uint32_t blockSize;
+	//(offset * divisor) >> 32 is the block index
+	uint32_t divisor;
+	uint32_t capacity;
+	uint32_t used;
+	uint32_t classIndex;
+	//the words before it have no free block
+	uint32_t freeHint;
+	//the pages mapped for it,more than one for a large object
+	uint32_t span;
+	//objects that must not move
+	uint32_t pinned;
+	bool isAvailable;
+	bool isYoung;
+	//the objects are moving out
+	bool isEvacuating;
+	//holds one large object
+	bool isLarge;
+	//the bits past the capacity are set,so they are never free
+	uint64_t allocBits[HEAP_BITMAP_WORDS];
+	//compared with usingMark,the objects don't carry it
+	uint64_t markBits[HEAP_BITMAP_WORDS];
+	//allocated after the last collection
+	uint64_t youngBits[HEAP_BITMAP_WORDS];
+} HeapPage;
+
+#define HEAP_PAGE_OF(object) ((HeapPage*)((uintptr_t)(object) & ~(uintptr_t)(HEAP_PAGE_SIZE - 1)))
+
+void heap_init();
+//release all pages,the objects must be freed before
+void heap_free();
+
+//the mark bit is set to mark,a size over HEAP_MAX_SIZE gets a large page
+Obj* heap_allocObject(uint64_t size, bool young, uint8_t mark);
+//give back an object nothing refers to yet
+void heap_freeObject(Obj* object);
+//keep it at its address,the compaction leaves its page alone
+void heap_pin(Obj* object);
+//call it after the blocks of the page are swept
+void heap_updatePage(HeapPage* page);
+
+//the pages mapped now
+uint64_t heap_pageCount();
+//the bytes of the allocated blocks and of all blocks
+void heap_occupancy(uint64_t* usedBytes, uint64_t* capacityBytes);
+
+//pick the sparse pages whose objects fit in the free blocks of the other pages,returns the count
+uint64_t heap_selectEvacuation();
+//release the evacuated pages
+void heap_finishEvacuation();
+
+static inline uint32_t heap_ctz(uint64_t bits) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return (uint32_t)index;
+#else
+	return (uint32_t)__builtin_ctzll(bits);
+#endif
+}
+
+//the words of the bitmaps in use
+static inline uint32_t heap_wordCount(HeapPage* page) {
+	return (page->capacity + 63) >> 6;
+}
+
+//masks the bits past the capacity
+static inline uint64_t heap_validBits(HeapPage* page, uint32_t word) {
+	uint32_t rest = page->capacity - (word << 6);
+	return (rest >= 64) ? UINT64_MAX : ((1ull << rest) - 1);
+}
+
+static inline uint32_t heap_blockIndex(HeapPage* page, Obj* object) {
+	return (uint32_t)(((uint64_t)((char*)object - page->blocks) * page->divisor) >> 32);
+}
+
+static inline Obj* heap_blockAt(HeapPage* page, uint32_t index) {
+	return (Obj*)(page->blocks + (uint64_t)index * page->blockSize);
+}
+
+static inline uint8_t heap_getMark(Obj* object) {
+	HeapPage* page = HEAP_PAGE_OF(object);
+	uint32_t index = heap_blockIndex(page, object);
+#if HEAP_ATOMIC_MARK
+	uint64_t word = ATOMIC_LOAD_U64(&page->markBits[index >> 6]);
+#else
+	uint64_t word = page->markBits[index >> 6];
+#endif
+	return (uint8_t)((word >> (index & 63)) & 1);
+}
+
+//returns the old mark
+static inline uint8_t heap_setMark(Obj* object, uint8_t mark) {
+	HeapPage* page = HEAP_PAGE_OF(object);
+	uint32_t index = heap_blockIndex(page, object);
+	uint64_t* word = &page->markBits[index >> 6];
+	uint64_t bit = 1ull << (index & 63);
+
+#if HEAP_ATOMIC_MARK
+	uint64_t old = mark ? ATOMIC_OR_U64(word, bit) : ATOMIC_AND_U64(word, ~bit);
+#else
+	uint64_t old = *word;
+	*word = mark ? (old | bit) : (old & ~bit);
+#endif
+	return (uint8_t)((old & bit) != 0);
+}
+
+//a moved object leaves its new address after the header
+#define HEAP_FORWARD_SLOT(object) (*(Obj**)((char*)(object) + sizeof(Obj*)))
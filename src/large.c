@@ -0,0 +1,154 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#if defined(__linux__)
+#define _GNU_SOURCE
+#elif !defined(_WIN32)
+#define _DEFAULT_SOURCE
+#endif
+#include "large.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define LARGE_ROUND(size) (((size) + LARGE_GRANULE - 1) & ~(uint64_t)(LARGE_GRANULE - 1))
+
+//the sweeping threads may free at the same time
+#if GC_THREADS > 1
+#if defined(_MSC_VER)
+#define ATOMIC_ADD_U64(ptr, value) ((void)_InterlockedExchangeAdd64((volatile long long*)(ptr), (long long)(value)))
+#else
+#define ATOMIC_ADD_U64(ptr, value) ((void)__atomic_fetch_add((ptr), (value), __ATOMIC_RELAXED))
+#endif
+#else
+#define ATOMIC_ADD_U64(ptr, value) ((void)(*(ptr) += (value)))
+#endif
+
+//the mappings are linked,so the vm can drop them all
+typedef struct LargeHeader {
+	struct LargeHeader* prev;
+	struct LargeHeader* next;
+	uint64_t size;
+} LargeHeader;
+
+#define LARGE_HEADER_SIZE ((sizeof(LargeHeader) + 15) & ~(uint64_t)15)
+#define LARGE_HEADER_OF(pointer) ((LargeHeader*)((char*)(pointer) - LARGE_HEADER_SIZE))
+#define LARGE_PAYLOAD_OF(header) ((void*)((char*)(header) + LARGE_HEADER_SIZE))
+
+static uint64_t mappedBytes = 0;
+static LargeHeader* mappings = NULL;
+
+static inline void linkMapping(LargeHeader* header, uint64_t size) {
+	header->size = size;
+	header->prev = NULL;
+	header->next = mappings;
+	if (mappings != NULL) {
+		mappings->prev = header;
+	}
+	mappings = header;
+}
+
+static inline void unlinkMapping(LargeHeader* header) {
+	if (header->prev != NULL) {
+		header->prev->next = header->next;
+	}
+	else {
+		mappings = header->next;
+	}
+	if (header->next != NULL) {
+		header->next->prev = header->prev;
+	}
+}
+
+static void* mapRange(uint64_t size) {
+#if defined(_WIN32)
+	void* result = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	void* result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (result == MAP_FAILED) result = NULL;
+#endif
+
+	if (result == NULL) {
+		fprintf(stderr, "Memory reallocation failed!\n");
+		exit(1);
+	}
+	return result;
+}
+
+static void unmapRange(void* pointer, uint64_t size) {
+#if defined(_WIN32)
+	(void)size;
+	VirtualFree(pointer, 0, MEM_RELEASE);
+#else
+	munmap(pointer, size);
+#endif
+}
+
+void* large_alloc(uint64_t size)
+{
+	size = LARGE_ROUND(LARGE_HEADER_SIZE + size);
+	ATOMIC_ADD_U64(&mappedBytes, size);
+
+	LargeHeader* header = (LargeHeader*)mapRange(size);
+	linkMapping(header, size);
+	return LARGE_PAYLOAD_OF(header);
+}
+
+void* large_realloc(void* pointer, uint64_t oldSize, uint64_t newSize)
+{
+	oldSize = LARGE_ROUND(LARGE_HEADER_SIZE + oldSize);
+	newSize = LARGE_ROUND(LARGE_HEADER_SIZE + newSize);
+	if (oldSize == newSize) return pointer;
+
+	ATOMIC_ADD_U64(&mappedBytes, newSize - oldSize);
+
+	LargeHeader* header = LARGE_HEADER_OF(pointer);
+	unlinkMapping(header);
+
+#if defined(__linux__)
+	//the kernel moves the pages,nothing is copied
+	LargeHeader* result = (LargeHeader*)mremap(header, oldSize, newSize, MREMAP_MAYMOVE);
+	if (result == MAP_FAILED) {
+		fprintf(stderr, "Memory reallocation failed!\n");
+		exit(1);
+	}
+#else
+	LargeHeader* result = (LargeHeader*)mapRange(newSize);
+	memcpy(result, header, (oldSize < newSize) ? oldSize : newSize);
+	unmapRange(header, oldSize);
+#endif
+
+	linkMapping(result, newSize);
+	return LARGE_PAYLOAD_OF(result);
+}
+
+void large_free(void* pointer, uint64_t size)
+{
+	LargeHeader* header = LARGE_HEADER_OF(pointer);
+	size = LARGE_ROUND(LARGE_HEADER_SIZE + size);
+	ATOMIC_ADD_U64(&mappedBytes, (uint64_t)0 - size);
+
+	unlinkMapping(header);
+	unmapRange(header, size);
+}
+
+void large_freeAll()
+{
+	while (mappings != NULL) {
+		LargeHeader* header = mappings;
+		mappings = header->next;
+		unmapRange(header, header->size);
+	}
+	mappedBytes = 0;
+}
+
+uint64_t large_mappedBytes()
+{
+	return mappedBytes;
+}
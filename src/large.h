@@ -0,0 +1,26 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#pragma once
+#include "common.h"
+
+//buffers of this size or more are mapped from the os directly
+#define LARGE_MIN_SIZE (256 * 1024)
+//the mappings are rounded up to it
+#define LARGE_GRANULE (4 * 1024)
+
+#define LARGE_FITS(size) ((size) >= LARGE_MIN_SIZE)
+
+//size must be at least LARGE_MIN_SIZE
+void* large_alloc(uint64_t size);
+//both sizes must be at least LARGE_MIN_SIZE,the contents are kept
+void* large_realloc(void* pointer, uint64_t oldSize, uint64_t newSize);
+//size must be the one it was allocated with
+void large_free(void* pointer, uint64_t size);
+//unmap the buffers still in use
+void large_freeAll();
+
+//the bytes mapped now
+uint64_t large_mappedBytes();
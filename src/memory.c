@@ -7,23 +7,67 @@
 #include "object.h"  
 #include "vm.h"
 #include "gc.h"
+#include "slab.h"
+#include "heap.h"
+#include "large.h"
+#include "arena.h"
 
-void* reallocate_no_gc(void* pointer, uint64_t oldSize, uint64_t newSize)
-{
-	vm.bytesAllocated_no_gc += newSize - oldSize;
+#if VM_ARENAS
+//the buffers are cut from the arena regions,so the vm drops them without their objects
+#define block_realloc arena_realloc
+#define block_free arena_freeBlock
+#else
+#define block_realloc(pointer, oldSize, newSize) mem_realloc(pointer, newSize)
+#define block_free mem_free
+#endif
+
+#if SLAB_ALLOCATOR
+//move the block between the slabs and the malloc heap when the size class changes
+static void* slab_realloc(void* pointer, uint64_t oldSize, uint64_t newSize) {
+	bool inSlab = (pointer != NULL) && SLAB_FITS(oldSize);
+	if (inSlab && SLAB_FITS(newSize) && SLAB_CLASS(oldSize) == SLAB_CLASS(newSize)) {
+		return pointer;
+	}
+
+	void* result = SLAB_FITS(newSize) ? slab_allocBlock(newSize) : block_realloc(NULL, 0, newSize);
+	if (result == NULL || pointer == NULL) return result;
+
+	memcpy(result, pointer, (oldSize < newSize) ? oldSize : newSize);
+	if (inSlab) {
+		slab_freeBlock(pointer, oldSize);
+	}
+	else {
+		block_free(pointer);
+	}
+	return result;
+}
+#endif
 
+static inline void* small_realloc(void* pointer, uint64_t oldSize, uint64_t newSize) {
 	if (newSize == 0) {
 		if (pointer != NULL) {
 #if LOG_EACH_MALLOC_INFO
 			printf("[mem] free %p\n", pointer);
 #endif
-			mem_free(pointer);
+#if SLAB_ALLOCATOR
+			if (SLAB_FITS(oldSize)) {
+				slab_freeBlock(pointer, oldSize);
+			}
+			else
+#endif
+			block_free(pointer);
 		}
 
 		return NULL;
 	}
 
-	void* result = mem_realloc(pointer, newSize);
+#if SLAB_ALLOCATOR
+	void* result = (SLAB_FITS(newSize) || (pointer != NULL && SLAB_FITS(oldSize)))
+		? slab_realloc(pointer, oldSize, newSize)
+		: block_realloc(pointer, oldSize, newSize);
+#else
+	void* result = block_realloc(pointer, oldSize, newSize);
+#endif
 
 #if LOG_EACH_MALLOC_INFO
 	printf("[mem] realloc %p -> %p, %zu\n", pointer, result, newSize);
@@ -37,44 +81,125 @@ void* reallocate_no_gc(void* pointer, uint64_t oldSize, uint64_t newSize)
 	return result;
 }
 
-void* reallocate(void* pointer, uint64_t oldSize, uint64_t newSize)
-{
-	vm.bytesAllocated += newSize - oldSize;
+#if LARGE_SPACE
+//move the buffer between the mappings and the smaller allocators
+static void* large_move(void* pointer, uint64_t oldSize, uint64_t newSize) {
+	bool isLarge = (pointer != NULL) && LARGE_FITS(oldSize);
+	if (isLarge) {
+		if (LARGE_FITS(newSize)) {
+			return large_realloc(pointer, oldSize, newSize);
+		}
+		if (newSize == 0) {
+			large_free(pointer, oldSize);
+			return NULL;
+		}
+	}
 
-	if (newSize > oldSize) {
-#if DEBUG_STRESS_GC
-		garbageCollect();
-#endif
-		if (vm.bytesAllocated > vm.nextGC) {
-			garbageCollect();
+	void* result = LARGE_FITS(newSize) ? large_alloc(newSize) : small_realloc(NULL, 0, newSize);
+	if (pointer != NULL) {
+		memcpy(result, pointer, (oldSize < newSize) ? oldSize : newSize);
+		if (isLarge) {
+			large_free(pointer, oldSize);
+		}
+		else {
+			small_realloc(pointer, oldSize, 0);
 		}
 	}
+	return result;
+}
 
-	if (newSize == 0) {
-		if (pointer != NULL) {
-#if LOG_EACH_MALLOC_INFO
-			printf("[mem] free %p\n", pointer);
+//the large buffers have a budget of their own,so they don't hurry the collection of small objects
+static void countLargeAllocation(uint64_t size) {
+	if (gcPhase == GC_IDLE && large_mappedBytes() + size > vm.nextLargeGC) {
+		majorCollect();
+	}
+	if (gcPolicy.heapLimit != 0) {
+		checkHeapLimit(size);
+	}
+}
 #endif
-			mem_free(pointer);
-		}
 
-		return NULL;
+static inline void* heap_realloc(void* pointer, uint64_t oldSize, uint64_t newSize) {
+#if LARGE_SPACE
+	if (LARGE_FITS(newSize) || (pointer != NULL && LARGE_FITS(oldSize))) {
+		return large_move(pointer, oldSize, newSize);
 	}
+#endif
+	return small_realloc(pointer, oldSize, newSize);
+}
 
-	void* result = mem_realloc(pointer, newSize);
+void* reallocate_no_gc(void* pointer, uint64_t oldSize, uint64_t newSize)
+{
+	vm.bytesAllocated_no_gc += newSize - oldSize;
 
-#if LOG_EACH_MALLOC_INFO
-	printf("[mem] realloc %p -> %p, %zu\n", pointer, result, newSize);
+	return heap_realloc(pointer, oldSize, newSize);
+}
+
+void* reallocate(void* pointer, uint64_t oldSize, uint64_t newSize)
+{
+	//the bytes that count for the gc trigger
+	uint64_t oldCounted = oldSize;
+	uint64_t newCounted = newSize;
+#if LARGE_SPACE
+	//the large space counts its own bytes
+	if (LARGE_FITS(oldSize)) oldCounted = 0;
+	if (LARGE_FITS(newSize)) newCounted = 0;
 #endif
 
-	if (result == NULL) {
-		fprintf(stderr, "Memory reallocation failed!\n");
-		exit(1);
+#if GC_THREADS > 1
+	//the sweeping threads only free
+	if (gcFreedBytes != NULL) {
+		*gcFreedBytes += oldCounted - newCounted;
+		//the slabs and the lists of the buffers are shared
+		slab_lock();
+		void* result = heap_realloc(pointer, oldSize, newSize);
+		slab_unlock();
+		return result;
+	}
+#endif
+#if LARGE_SPACE
+	if (LARGE_FITS(newSize) && newSize > oldSize) {
+		countLargeAllocation(newSize - (LARGE_FITS(oldSize) ? oldSize : 0));
+	}
+#endif
+	if (newCounted > oldCounted) {
+		countAllocation(newCounted - oldCounted);
+	}
+	else {
+		vm.bytesAllocated -= oldCounted - newCounted;
 	}
 
-	return result;
+	return heap_realloc(pointer, oldSize, newSize);
+}
+
+void countAllocation(uint64_t size)
+{
+	vm.bytesAllocated += size;
+
+#if DEBUG_STRESS_GC
+	stressCollect();
+#endif
+	if (gcPhase != GC_IDLE) {
+		if (vm.bytesAllocated > vm.nextGCStep) {
+			incrementalStep();
+		}
+	}
+	else {
+		//the nursery first,a full collection only if the survivors keep the heap over its threshold
+		if (vm.bytesAllocated > vm.nextMinorGC) {
+			minorCollect();
+			if (vm.bytesAllocated > vm.nextGC) {
+				majorCollect();
+			}
+		}
+	}
+
+	if (gcPolicy.heapLimit != 0) {
+		checkHeapLimit(0);
+	}
 }
 
+//the block of a gc object belongs to its page,the sweep releases it
 void freeObject(Obj* object) {
 #if DEBUG_LOG_GC
 	printf("[gc] %p free (%s)\n", (void*)object, objTypeInfo[object->type]);
@@ -84,32 +209,24 @@ void freeObject(Obj* object) {
 	case OBJ_CLASS: {
 		ObjClass* klass = (ObjClass*)object;
 		table_free(&klass->methods);
-		FREE(ObjClass, object);
 		break;
 	}
 	case OBJ_INSTANCE: {
 		ObjInstance* instance = (ObjInstance*)object;
 		table_free(&instance->fields);
-		FREE(ObjInstance, object);
-		break;
-	}
-	case OBJ_CLOSURE: {
-		ObjClosure* closure = (ObjClosure*)object;
-		FREE_ARRAY(ObjUpvalue*, closure->upvalues, closure->upvalueCount);
-
-		FREE(ObjClosure, object);
-		break;
-	}
-	case OBJ_BOUND_METHOD: {
-		FREE(ObjBoundMethod, object);
 		break;
 	}
+	case OBJ_CLOSURE:
+	case OBJ_BOUND_METHOD:
 	case OBJ_UPVALUE:
-		FREE(ObjUpvalue, object);
+		//nothing outside the block
 		break;
 	case OBJ_FUNCTION: {
 		ObjFunction* function = (ObjFunction*)object;
 		chunk_free(&function->chunk);
+		if (function->lazy != NULL) {
+			FREE_FLEX_NO_GC(LazyBody, function->lazy, char, function->lazy->length + 1);
+		}
 		FREE_NO_GC(ObjFunction, object);
 		break;
 	}
@@ -117,48 +234,105 @@ void freeObject(Obj* object) {
 		FREE_NO_GC(ObjNative, object);
 		break;
 	case OBJ_STRING: {
-		ObjString* string = (ObjString*)object;
-		FREE_FLEX_NO_GC(ObjString, string, char, string->length + 1);//FAM object include'\0
+		//a runtime string is all in its block
+		if (object->isStatic) {
+			ObjString* string = (ObjString*)object;
+			FREE_FLEX_NO_GC(ObjString, string, char, string->length + 1);//FAM object include'\0
+		}
 		break;
 	case OBJ_ARRAY:
 	{
 		//they share the same struct
 		ObjArray* array = (ObjArray*)object;
-		FREE_ARRAY(Value , array->elements, array->capacity);
+		if (!ARRAY_IS_INLINE(array)) {
+			FREE_ARRAY(Value, array->elements, array->capacity);
+		}
 #if DEBUG_LOG_GC
 		printf("[gc] %p free buffer : %llu\n", (void*)array->payload, (uint64_t)array->capacity * sizeof(Value));
 #endif
-		FREE(ObjArray, object);
 		break;
 	}
 	}
 	}
 }
 
+//the compiler has proved nothing else refers to it,the gc takes it if it's old or a cycle is running
+void releaseObject(Obj* object)
+{
+	if (object->isOld || object->isStatic || gcPhase != GC_IDLE) return;
+
+	uint64_t blockSize = HEAP_PAGE_OF(object)->blockSize;
+	freeObject(object);
+	heap_freeObject(object);
+	vm.bytesAllocated -= blockSize;
+}
+
 void freeObjects()
 {
 
 #if DEBUG_LOG_GC
 	printf("-- free dynamic objects\n");
 #endif
-	Obj* object = vm.objects;
-	while (object != NULL) {
-		Obj* next = OBJ_PTR_GET_NEXT(object);
-		freeObject(object);
-		object = next;
+	//the marking thread may be running
+	waitForGC();
+
+#if !VM_ARENAS
+	for (HeapPage* page = vm.pages; page != NULL; page = page->allNext) {
+		uint32_t words = heap_wordCount(page);
+
+		for (uint32_t i = 0; i < words; ++i) {
+			uint64_t bits = page->allocBits[i] & heap_validBits(page, i);
+
+			while (bits != 0) {
+				freeObject(heap_blockAt(page, (i << 6) + heap_ctz(bits)));
+				bits &= bits - 1;
+			}
+		}
 	}
+#endif
+	//their buffers are left to freeBuffers
+	heap_free();
 
 	if (vm.grayStack != NULL) {
 		mem_free(vm.grayStack);
 	}
 
+	if (vm.rememberedSet != NULL) {
+		mem_free(vm.rememberedSet);
+	}
+
+	if (vm.overwrittenSet != NULL) {
+		mem_free(vm.overwrittenSet);
+	}
+
+	FREE_ARRAY_NO_GC(ObjString*, vm.youngStrings, vm.youngStringCapacity);
+	vm.youngStrings = NULL;
+	vm.youngStringCount = 0;
+	vm.youngStringCapacity = 0;
+
 #if DEBUG_LOG_GC
 	printf("-- free static objects\n");
 #endif
-	Obj* object_no_gc = vm.objects_no_gc;
-	while (object_no_gc != NULL) {
-		Obj* next = OBJ_PTR_GET_NEXT(object_no_gc);
-		freeObject(object_no_gc);
-		object_no_gc = next;
+#if !VM_ARENAS
+	for (uint64_t i = 0; i < vm.staticCount; ++i) {
+		freeObject(vm.staticObjects[i]);
 	}
-}
\ No newline at end of file
+#endif
+	FREE_ARRAY_NO_GC(Obj*, vm.staticObjects, vm.staticCapacity);
+	vm.staticObjects = NULL;
+	vm.staticCount = 0;
+	vm.staticCapacity = 0;
+}
+
+void freeBuffers()
+{
+#if VM_ARENAS
+	arena_free();
+#endif
+#if LARGE_SPACE
+	large_freeAll();
+#endif
+#if SLAB_ALLOCATOR
+	slab_free();
+#endif
+}
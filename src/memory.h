@@ -11,6 +11,8 @@
 	((capacity) < 16 ? 16 : (capacity << 1))
 
 void* reallocate(void* pointer, uint64_t oldSize, uint64_t newSize);
+//count the bytes of a new gc object,may collect
+void countAllocation(uint64_t size);
 
 #define GROW_ARRAY(type, pointer, oldCount, newCount) \
 	((type*)reallocate(pointer, sizeof(type) * (oldCount), sizeof(type) * (newCount)))
@@ -42,4 +44,8 @@ void* reallocate_no_gc(void* pointer, uint64_t oldSize, uint64_t newSize);
 #define FREE_FLEX_NO_GC(type,pointer,flexType,count) reallocate_no_gc(pointer, sizeof(type) + sizeof(flexType) * count, 0)
 
 void freeObject(Obj* object);
-void freeObjects();
\ No newline at end of file
+//give the block of a young object back before the gc finds it dead
+void releaseObject(Obj* object);
+void freeObjects();
+//drop the slab pages,the arena regions and the large mappings still in use
+void freeBuffers();
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "nativeBuiltin.h"
 #include "vm.h"
 #include "object.h"
+#include "gc.h"
 //Array
 
 static Value lengthNative(int argCount, Value* args)
@@ -41,13 +42,15 @@ static Value pushNative(int argCount, Value* args) {
 					newSize = max(newSize, (array->capacity * 3) >> 1);
 				}
 
-				reserveArray(array, newSize);
+				//the vm reports the heap limit when the native returns
+				if (!reserveArray(array, newSize)) return NIL_VAL;
 			}
 
 			//no type check,so it's faster
 			for (uint32_t i = 1; i < argCount; ++i) {
-					array->elements[array->length] = args[i];
+					storeValue(&array->elements[array->length], args[i]);
 					array->length++;
+					writeBarrier(&array->obj, args[i]);
 				}
 		}
 
@@ -64,6 +67,10 @@ static Value popNative(int argCount, Value* args) {
 
 		if (array->length > 0) {
 			Value value = array->elements[array->length - 1];
+			overwriteBarrier(value);
+#if GC_CONCURRENT
+			storeValue(&array->elements[array->length - 1], NIL_VAL);
+#endif
 			array->length--;
 			return value;
 		}
@@ -89,7 +96,7 @@ static Value resizeNative(int argCount, Value* args) {
 			length = (uint64_t)size;
 
 			if (length > array->length) {
-				reserveArray(array, length);
+				if (!reserveArray(array, length)) return NIL_VAL;
 
 				//no type check,so it's faster
 				while (array->length < length) {
@@ -98,6 +105,13 @@ static Value resizeNative(int argCount, Value* args) {
 					}
 			}
 			else {
+#if GC_CONCURRENT
+				//keep the tail nil for the marking thread
+				for (uint64_t i = length; i < array->length; ++i) {
+					overwriteBarrier(array->elements[i]);
+					storeValue(&array->elements[i], NIL_VAL);
+				}
+#endif
 				array->length = length;//and do nothing
 			}
 
@@ -36,7 +36,7 @@ static Value charAtNative(int argCount, Value* args) {
 			if (indexf < 0 || indexf >= length) return NIL_VAL;//out of range
 			uint32_t index = (uint32_t)indexf;
 
-			return OBJ_VAL(copyString(stringPtr + index, 1, false));
+			return OBJ_VAL(copyRuntimeString(stringPtr + index, 1));
 		}
 	}
 
@@ -7,6 +7,9 @@
 #include "vm.h"
 #include "object.h"
 #include "gc.h"
+#include "heap.h"
+#include "snapshot.h"
+#include "profiler.h"
 //System
 
 //force do gc
@@ -19,6 +22,140 @@ static Value totalBytesNative(int argCount, Value* args) {
 	return NUMBER_VAL((double)(vm.bytesAllocated_no_gc + vm.bytesAllocated));
 }
 
+//a byte count of the gc policy,returns the old value,or the current one without an argument
+static Value gcSize(uint64_t* size, int argCount, Value* args) {
+	Value old = NUMBER_VAL((double)*size);
+	if (argCount >= 1) {
+		if (!IS_NUMBER(args[0]) || !(AS_NUMBER(args[0]) >= 0)) return NAN_VAL;
+		*size = (uint64_t)AS_NUMBER(args[0]);
+	}
+	return old;
+}
+
+//the first major gc threshold,it also moves the current one if no cycle runs
+static Value gcBeginNative(int argCount, Value* args) {
+	Value old = gcSize(&gcPolicy.heapBegin, argCount, args);
+	if (argCount >= 1 && IS_NUMBER(args[0]) && AS_NUMBER(args[0]) >= 0 && gcPhase == GC_IDLE) {
+		changeNextGC(gcPolicy.heapBegin);
+	}
+	return old;
+}
+
+static Value gcMinNative(int argCount, Value* args) {
+	return gcSize(&gcPolicy.heapMin, argCount, args);
+}
+
+static Value gcMaxNative(int argCount, Value* args) {
+	return gcSize(&gcPolicy.heapMax, argCount, args);
+}
+
+static Value gcLimitNative(int argCount, Value* args) {
+	return gcSize(&gcPolicy.heapLimit, argCount, args);
+}
+
+static Value gcGrowNative(int argCount, Value* args) {
+	Value old = NUMBER_VAL(gcPolicy.growFactor);
+	if (argCount >= 1) {
+		//the same range as --gc-grow
+		if (!IS_NUMBER(args[0]) || !setGrowFactor(AS_NUMBER(args[0]))) return NAN_VAL;
+	}
+	return old;
+}
+
+//the longest incremental step in microseconds
+static Value gcPauseNative(int argCount, Value* args) {
+	return gcSize(&gcPolicy.maxPause, argCount, args);
+}
+
+static Value gcThreadsNative(int argCount, Value* args) {
+	Value old = NUMBER_VAL((double)gcPolicy.threads);
+	if (argCount >= 1) {
+		//the same range as --gc-threads
+		if (!IS_NUMBER(args[0]) || !setGCThreads(AS_NUMBER(args[0]))) return NAN_VAL;
+	}
+	return old;
+}
+
+static Value gcAdaptiveNative(int argCount, Value* args) {
+	Value old = BOOL_VAL(gcPolicy.adaptive);
+	if (argCount >= 1) {
+		if (!IS_BOOL(args[0])) return NAN_VAL;
+		gcPolicy.adaptive = AS_BOOL(args[0]);
+	}
+	return old;
+}
+
+//the instance is on the stack while the fields are set
+static ObjInstance* pushObject() {
+	ObjInstance* instance = newInstance(&vm.emptyClass);
+	stack_push(OBJ_VAL(instance));
+	return instance;
+}
+
+static void setField(ObjInstance* instance, C_STR name, Value value) {
+	tableSet(&instance->fields, copyString(name, (uint32_t)strlen(name), false), value);
+	writeBarrier(&instance->obj, value);
+}
+
+//{types:{string:{count,bytes,buffers},...},gc:{...},heap:{...}},a snapshot at the call
+static Value heapStatsNative(int argCount, Value* args) {
+	TypeStats stats[OBJ_TYPE_COUNT];
+	collectTypeStats(stats);
+
+	ObjInstance* result = pushObject();
+	ObjInstance* types = pushObject();
+	setField(result, "types", OBJ_VAL(types));
+	for (uint32_t i = 0; i < OBJ_TYPE_COUNT; ++i) {
+		ObjInstance* type = pushObject();
+		setField(types, objTypeInfo[i], OBJ_VAL(type));
+		setField(type, "count", NUMBER_VAL((double)stats[i].count));
+		setField(type, "bytes", NUMBER_VAL((double)stats[i].bytes));
+		setField(type, "buffers", NUMBER_VAL((double)stats[i].bufferBytes));
+		stack_pop();
+	}
+	stack_pop();
+
+	ObjInstance* gc = pushObject();
+	setField(result, "gc", OBJ_VAL(gc));
+	setField(gc, "minor", NUMBER_VAL((double)gcStats.minorCount));
+	setField(gc, "major", NUMBER_VAL((double)gcStats.majorCount));
+	setField(gc, "lastPause", NUMBER_VAL(gcStats.lastPause));
+	setField(gc, "maxPause", NUMBER_VAL(gcStats.maxPause));
+	setField(gc, "totalPause", NUMBER_VAL(gcStats.totalPause));
+	setField(gc, "freedBytes", NUMBER_VAL((double)gcStats.freedBytes));
+	setField(gc, "freedObjects", NUMBER_VAL((double)gcStats.freedObjects));
+	setField(gc, "survivors", NUMBER_VAL((double)gcStats.survivors));
+	setField(gc, "totalFreedBytes", NUMBER_VAL((double)gcStats.totalFreedBytes));
+	setField(gc, "totalFreedObjects", NUMBER_VAL((double)gcStats.totalFreedObjects));
+	stack_pop();
+
+	uint64_t usedBytes, capacityBytes;
+	heap_occupancy(&usedBytes, &capacityBytes);
+	ObjInstance* heap = pushObject();
+	setField(result, "heap", OBJ_VAL(heap));
+	setField(heap, "allocated", NUMBER_VAL((double)vm.bytesAllocated));
+	setField(heap, "used", NUMBER_VAL((double)usedBytes));
+	setField(heap, "capacity", NUMBER_VAL((double)capacityBytes));
+	setField(heap, "pages", NUMBER_VAL((double)heap_pageCount()));
+	stack_pop();
+
+	return stack_pop();
+}
+
+//writes the live objects to the path,returns false if it can't
+static Value heapSnapshotNative(int argCount, Value* args) {
+	if (argCount < 1 || !IS_STRING(args[0])) return BOOL_VAL(false);
+	return BOOL_VAL(snapshot_write(AS_STRING(args[0])->chars));
+}
+
+#if ALLOC_PROFILER
+//writes the allocation sites sampled so far,returns false if the profiler is off
+static Value allocProfileNative(int argCount, Value* args) {
+	if (argCount < 1 || !IS_STRING(args[0])) return BOOL_VAL(false);
+	return BOOL_VAL(profiler_write(AS_STRING(args[0])->chars));
+}
+#endif
+
 //Print all the parameters
 static Value logNative(int argCount, Value* args) {
 	for (int i = 0; i < argCount;) {
@@ -39,5 +176,18 @@ COLD_FUNCTION
 void importNative_system() {
 	defineNative_system("gc", gcNative);
 	defineNative_system("total", totalBytesNative);
+	defineNative_system("gcBegin", gcBeginNative);
+	defineNative_system("gcMin", gcMinNative);
+	defineNative_system("gcMax", gcMaxNative);
+	defineNative_system("gcLimit", gcLimitNative);
+	defineNative_system("gcGrow", gcGrowNative);
+	defineNative_system("gcAdaptive", gcAdaptiveNative);
+	defineNative_system("gcPause", gcPauseNative);
+	defineNative_system("gcThreads", gcThreadsNative);
+	defineNative_system("heapStats", heapStatsNative);
+	defineNative_system("heapSnapshot", heapSnapshotNative);
+#if ALLOC_PROFILER
+	defineNative_system("allocProfile", allocProfileNative);
+#endif
 	defineNative_system("log", logNative);
 }
\ No newline at end of file
@@ -8,18 +8,20 @@
 #include "hash.h"
 #include "memory.h"
 #include "gc.h"
+#include "heap.h"
+#include "profiler.h"
 
-#if DEBUG_LOG_GC
 const C_STR objTypeInfo[] = {
-	[OBJ_CLASS] = {"class"},
-	[OBJ_CLOSURE] = {"closure"},
-	[OBJ_FUNCTION] = {"function"},
-	[OBJ_NATIVE] = {"native"},
-	[OBJ_UPVALUE] = {"upValue"},
-	[OBJ_STRING] = {"string"},
-	[OBJ_ARRAY] = {"array"},
+	[OBJ_CLASS] = "class",
+	[OBJ_CLOSURE] = "closure",
+	[OBJ_FUNCTION] = "function",
+	[OBJ_NATIVE] = "native",
+	[OBJ_UPVALUE] = "upvalue",
+	[OBJ_STRING] = "string",
+	[OBJ_ARRAY] = "array",
+	[OBJ_BOUND_METHOD] = "boundMethod",
+	[OBJ_INSTANCE] = "instance",
 };
-#endif
 
 #define ALLOCATE_OBJ(type, objectType) \
     (type*)allocateObject(sizeof(type), objectType)
@@ -27,37 +29,75 @@ const C_STR objTypeInfo[] = {
 #define ALLOCATE_FLEX_OBJ(type,objectType,byteSize) \
     (type*)allocateObject(byteSize, objectType)
 
+//the static objects are freed with the vm
+static void addStaticObject(Obj* object) {
+	if (vm.staticCapacity < vm.staticCount + 1) {
+		uint64_t oldCapacity = vm.staticCapacity;
+		vm.staticCapacity = GROW_CAPACITY(oldCapacity);
+		vm.staticObjects = GROW_ARRAY_NO_GC(Obj*, vm.staticObjects, oldCapacity, vm.staticCapacity);
+	}
+
+	vm.staticObjects[vm.staticCount++] = object;
+}
+
+static Obj* allocateStaticObject(uint64_t size, ObjType type) {
+	Obj* object = (Obj*)reallocate_no_gc(NULL, 0, size);
+	object->type = type;
+	object->isOld = true;
+	object->isRemembered = false;
+	object->isStatic = true;
+	addStaticObject(object);
+	profiler_count(size, type);
+
+#if DEBUG_LOG_GC
+	printf("[gc] %p allocate %zu for (%s)\n", (void*)object, size, objTypeInfo[type]);
+#endif
+
+	return object;
+}
+
 HOT_FUNCTION
-static Obj* allocateObject(uint64_t size, ObjType type) {
-	Obj* object = NULL;
+static Obj* allocateHeapObject(uint64_t size, ObjType type) {
+	//may collect,so decide the generation after it
+	countAllocation(HEAP_BLOCK_SIZE(size));
+
+	//the running major gc sweeps the objects allocated while marking,no need to promote them later
+	bool young = (gcPhase != GC_MARKING);
+	uint8_t mark = !usingMark;
+#if GC_CONCURRENT
+	//not in the snapshot,keep it for this cycle
+	if (!young) mark = usingMark;
+#endif
+	Obj* object = heap_allocObject(size, young, mark);
+	object->type = type;
+	object->isOld = !young;
+	object->isRemembered = false;
+	object->isStatic = false;
+	profiler_count(HEAP_BLOCK_SIZE(size), type);
+
+#if DEBUG_LOG_GC
+	printf("[gc] %p allocate %zu for (%s)\n", (void*)object, size, objTypeInfo[type]);
+#endif
 
-	//link the objects
+	return object;
+}
+
+HOT_FUNCTION
+static Obj* allocateObject(uint64_t size, ObjType type) {
 	switch (type) {
 	case OBJ_FUNCTION:
 	case OBJ_NATIVE:
 	case OBJ_STRING:
-		object = (Obj*)reallocate_no_gc(NULL, 0, size);
-		OBJ_PTR_SET_NEXT(object, vm.objects_no_gc);
-		object->type = type;
-		object->isMarked = !usingMark;
-		vm.objects_no_gc = object;
-		break;
+		return allocateStaticObject(size, type);
 	default:
-		object = (Obj*)reallocate(NULL, 0, size);
-		OBJ_PTR_SET_NEXT(object, vm.objects);
-		object->type = type;
-		object->isMarked = !usingMark;
-		vm.objects = object;
-		break;
+		return allocateHeapObject(size, type);
 	}
-
-#if DEBUG_LOG_GC
-	printf("[gc] %p allocate %zu for (%s)\n", (void*)object, size, objTypeInfo[type]);
-#endif
-
-	return object;
 }
 
+//a string made by the running program,it dies with its last reference
+#define ALLOCATE_RUNTIME_STRING(byteSize) \
+    (ObjString*)allocateHeapObject(byteSize, OBJ_STRING)
+
 HOT_FUNCTION
 ObjUpvalue* newUpvalue(Value* slot)
 {
@@ -73,23 +113,25 @@ ObjFunction* newFunction() {
 	function->arity = 0;
 	function->upvalueCount = 0;
 	function->id = vm.functionID++;//unique id
+	function->inlineSize = 0;
 	function->name = NULL;
+	function->lazy = NULL;
 	chuck_init(&function->chunk);
 	return function;
 }
 
 HOT_FUNCTION
 ObjClosure* newClosure(ObjFunction* function) {
-	ObjUpvalue** upvalues = ALLOCATE(ObjUpvalue*, function->upvalueCount);
-	for (uint32_t i = 0; i < function->upvalueCount; i++) {
-		upvalues[i] = NULL;
-	}
-
-	ObjClosure* closure = ALLOCATE_OBJ(ObjClosure, OBJ_CLOSURE);
+	uint64_t heapSize = sizeof(ObjClosure) + sizeof(Value) * function->upvalueCount;
+	ObjClosure* closure = ALLOCATE_FLEX_OBJ(ObjClosure, OBJ_CLOSURE, heapSize);
 	closure->function = function;
-	closure->upvalues = upvalues;
 	closure->upvalueCount = function->upvalueCount;
 
+	//gc might scan it before captured
+	for (uint32_t i = 0; i < function->upvalueCount; i++) {
+		closure->upvalues[i] = NIL_VAL;
+	}
+
 	return closure;
 }
 
@@ -120,42 +162,119 @@ ObjClass* newClass(ObjString* name)
 
 HOT_FUNCTION
 ObjInstance* newInstance(ObjClass* klass) {
-	ObjInstance* instance = ALLOCATE_OBJ(ObjInstance, OBJ_INSTANCE);
+	ObjInstance* instance = ALLOCATE_FLEX_OBJ(ObjInstance, OBJ_INSTANCE, sizeof(ObjInstance) + TABLE_STORAGE_SIZE(INSTANCE_INLINE_SLOTS));
 	instance->klass = klass;
-	instance->fields.type = TABLE_NORMAL;
-	table_init(&instance->fields);
+	instance->bound = NULL;
+	table_initInline(&instance->fields, INSTANCE_INLINE_ENTRIES(instance), INSTANCE_INLINE_SLOTS);
 	return instance;
 }
 
 HOT_FUNCTION
-ObjArray* newArray() {
-	ObjArray* array = ALLOCATE_OBJ(ObjArray, OBJ_ARRAY);
-	array->capacity = 0;
+ObjArray* newArray(uint32_t capacity) {
+	if (capacity < ARRAY_INLINE_MIN) capacity = ARRAY_INLINE_MIN;
+
+	ObjArray* array = ALLOCATE_FLEX_OBJ(ObjArray, OBJ_ARRAY, sizeof(ObjArray) + sizeof(Value) * capacity);
+	array->capacity = capacity;
 	array->length = 0;
-	array->elements = NULL;
+	array->elements = array->inlineElements;
+#if GC_CONCURRENT
+	//the marking thread may see a new length before the new element
+	for (uint32_t i = 0; i < capacity; ++i) {
+		array->inlineElements[i] = NIL_VAL;
+	}
+#endif
 	return array;
 }
 
 HOT_FUNCTION
-void reserveArray(ObjArray* array, uint64_t size)
+bool reserveArray(ObjArray* array, uint64_t size)
 {
+	if (size <= array->capacity) return true;
 	size = (size + 7) & ~7;
-	if (size < array->capacity) return;
 	if (size > ARRAYLIKE_MAX) {
 		fprintf(stderr, "Array size overflow");
 		exit(1);
 	}
+	//refuse the growth up front,the array keeps its old payload
+	if (gcPolicy.heapLimit != 0 && !checkHeapLimit(sizeof(Value) * (size - array->capacity))) {
+		return false;
+	}
 
+#if GC_CONCURRENT
+	//the marking thread may be reading the old payload,so don't realloc it
+	Value* newPayload = ALLOCATE(Value, size);
+	if (array->length > 0) {
+		memcpy(newPayload, array->elements, sizeof(Value) * array->length);
+	}
+	//the tail is nil,the marking thread may see a new length before the new element
+	for (uint64_t i = array->length; i < size; ++i) {
+		newPayload[i] = NIL_VAL;
+	}
+
+	bool locked = gcLockBuffers();
+	if (!ARRAY_IS_INLINE(array)) {
+		FREE_ARRAY(Value, array->elements, array->capacity);
+	}
+	array->elements = newPayload;
+	array->capacity = size;
+	gcUnlockBuffers(locked);
+#else
 #define GROW_TYPED_ARRAY(type, ptr, size) reallocate(ptr, sizeof(type) * array->capacity, sizeof(type) * size)
-	Value* newPayload = GROW_TYPED_ARRAY(Value, array->elements, size);
+	Value* newPayload;
+	if (ARRAY_IS_INLINE(array)) {
+		//the block keeps its slots,the elements leave them
+		newPayload = ALLOCATE(Value, size);
+		memcpy(newPayload, array->elements, sizeof(Value) * array->length);
+	}
+	else {
+		newPayload = GROW_TYPED_ARRAY(Value, array->elements, size);
+	}
 	array->elements = newPayload;
 	array->capacity = size;
 #undef GROW_TYPED_ARRAY
+#endif
+	return true;
 }
 
 //if find deduplicate one return it else null
 static inline ObjString* deduplicateString(C_STR chars, uint32_t length, uint64_t hash) {
-	return tableFindString(&vm.strings, chars, length, hash);
+	ObjString* string = tableFindString(&vm.strings, chars, length, hash);
+	//the pool is weak,the marking may not have reached it
+	if (string != NULL) weakReadBarrier((Obj*)string);
+	return string;
+}
+
+//the compiler and the natives refer to it from static objects,so it can't die or move
+static void pinString(ObjString* string) {
+	if (string->obj.isStatic) return;
+
+	Entry* entry = getStringEntryInPool(string);
+	if (IS_BOOL(entry->value) && !AS_BOOL(entry->value)) {
+		entry->value = BOOL_VAL(true);
+		string->obj.isOld = true;
+		heap_pin((Obj*)string);
+	}
+}
+
+//the pool only holds it weakly,the gc drops it when nothing else refers to it
+static void internRuntimeString(ObjString* string) {
+	tableSet(&vm.strings, string, BOOL_VAL(false));
+
+	//the minor gc checks the young ones only
+	if (!string->obj.isOld) {
+		if (vm.youngStringCapacity < vm.youngStringCount + 1) {
+			uint64_t oldCapacity = vm.youngStringCapacity;
+			vm.youngStringCapacity = GROW_CAPACITY(oldCapacity);
+			vm.youngStrings = GROW_ARRAY_NO_GC(ObjString*, vm.youngStrings, oldCapacity, vm.youngStringCapacity);
+		}
+		vm.youngStrings[vm.youngStringCount++] = string;
+	}
+}
+
+//drop a runtime string that has an interned twin
+static void releaseRuntimeString(ObjString* string, uint64_t heapSize) {
+	heap_freeObject((Obj*)string);
+	vm.bytesAllocated -= HEAP_BLOCK_SIZE(heapSize);
 }
 
 //will check '\\' '\"'
@@ -170,7 +289,10 @@ ObjString* copyString(C_STR chars, uint32_t length, bool escapeChars)
 
 		//find deduplicate one
 		string = deduplicateString(chars, length, hash);
-		if (string == NULL) {
+		if (string != NULL) {
+			pinString(string);
+		}
+		else {
 			//create string
 			heapSize += length;
 			string = ALLOCATE_FLEX_OBJ(ObjString, OBJ_STRING, heapSize);
@@ -261,17 +383,41 @@ ObjString* copyString(C_STR chars, uint32_t length, bool escapeChars)
 			return string;
 		}
 		else {
-			//free memory this should be the first obj of the object list
-			vm.objects_no_gc = OBJ_PTR_GET_NEXT(&string->obj);
+			//free memory this should be the last static object
+			vm.staticCount--;
 			freeObject((Obj*)string);
+			pinString(interned);
 			return interned;
 		}
 	}
 }
 
+ObjString* copyRuntimeString(C_STR chars, uint32_t length)
+{
+	uint64_t hash = HASH_64bits(chars, length);
+
+	ObjString* string = deduplicateString(chars, length, hash);
+	if (string != NULL) return string;
+
+	//grow the pool first,so no gc runs between the allocation and the interning
+	tableReserve(&vm.strings, 1);
+
+	string = ALLOCATE_RUNTIME_STRING(sizeof(ObjString) + length + 1);
+	memcpy(string->chars, chars, length);
+	string->chars[length] = '\0';
+	string->length = length;
+	string->hash = hash;
+	string->symbol = INVALID_OBJ_STRING_SYMBOL;
+
+	internRuntimeString(string);
+	return string;
+}
+
 ObjString* connectString(ObjString* strA, ObjString* strB) {
-	uint32_t heapSize = sizeof(ObjString) + strA->length + strB->length + 1;
-	ObjString* string = ALLOCATE_FLEX_OBJ(ObjString, OBJ_STRING, heapSize);
+	uint64_t heapSize = sizeof(ObjString) + (uint64_t)strA->length + strB->length + 1;
+	//grow the pool first,so no gc runs between the allocation and the interning
+	tableReserve(&vm.strings, 1);
+	ObjString* string = ALLOCATE_RUNTIME_STRING(heapSize);
 
 	memcpy(string->chars, strA->chars, strA->length);
 	memcpy(string->chars + strA->length, strB->chars, strB->length);
@@ -285,15 +431,11 @@ ObjString* connectString(ObjString* strA, ObjString* strB) {
 	//do deduplicate
 	ObjString* interned = deduplicateString(string->chars, string->length, string->hash);
 	if (interned == NULL) {
-		//stack_push(OBJ_VAL(string));
-		tableSet(&vm.strings, string, BOOL_VAL(true));
-		//stack_pop();
+		internRuntimeString(string);
 		return string;
 	}
 	else {
-		//free memory this should be the first obj of the object list
-		vm.objects_no_gc = OBJ_PTR_GET_NEXT(&string->obj);
-		freeObject((Obj*)string);
+		releaseRuntimeString(string, heapSize);
 		return interned;
 	}
 }
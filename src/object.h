@@ -22,7 +22,9 @@ typedef enum {
 	OBJ_CLASS,
 	OBJ_INSTANCE,
 	//array
-	OBJ_ARRAY
+	OBJ_ARRAY,
+
+	OBJ_TYPE_COUNT
 } ObjType;
 
 //@object.type()
@@ -40,29 +42,38 @@ typedef enum {
 	TYPE_STRING_COUNT,
 } TypeStringType;
 
-#if DEBUG_LOG_GC
+//the names in the logs and the heap stats
 extern const C_STR objTypeInfo[];
-#endif
 
+//the mark bit and the link are in the page of the object
 struct Obj {
 	uint8_t type;
-	uint8_t isMarked;
-	struct Obj* next;
+	uint8_t isOld; //survived a collection,or static
+	uint8_t isRemembered; //old object in the remembered set
+	uint8_t isStatic; //not in a heap page,never collected
 };
-#define OBJ_PTR_SET_NEXT(obj,nextPtr)	((obj)->next = nextPtr)
-#define OBJ_PTR_GET_NEXT(obj)			((obj)->next)
 
 static inline Obj stateLess_obj_header(ObjType objType) {
-	return (Obj) { .next = NULL, .isMarked = 1, .type = objType };
+	return (Obj) { .isOld = 1, .isRemembered = 0, .isStatic = 1, .type = objType };
 }
 
+//source of a function body that is compiled on the first call
+typedef struct {
+	uint32_t line;
+	uint32_t constCount; //global constants declared before the function
+	uint32_t length;
+	char source[]; // flexible array members FAM
+} LazyBody;
+
 typedef struct {
 	Obj obj;
 	uint16_t arity;
 	uint16_t upvalueCount;
 	uint32_t id;
+	uint16_t inlineSize; //size of the inlinable body, 0 if not inlinable
 	Chunk chunk;
 	ObjString* name;
+	LazyBody* lazy; //not null until the body is compiled
 } ObjFunction;
 
 typedef struct ObjUpvalue {
@@ -72,11 +83,12 @@ typedef struct ObjUpvalue {
 	struct ObjUpvalue* next;
 } ObjUpvalue;
 
+//flat captured values are stored inline,mutable captures are ObjUpvalue
 typedef struct {
 	Obj obj;
 	uint32_t upvalueCount;
-	ObjUpvalue** upvalues;
 	ObjFunction* function;
+	Value upvalues[]; // flexible array members FAM
 } ObjClosure;
 
 typedef struct {
@@ -104,8 +116,16 @@ typedef struct {
 	Obj obj;
 	ObjClass* klass;
 	Table fields;
+	//the method read last,reused while it is the same
+	ObjBoundMethod* bound;
 } ObjInstance;
 
+//the first fields are in the block after the struct,the table moves them out when it grows
+//the slots of that table,one stays empty so 4 slots hold TABLE_USABLE(4) = 3 fields
+//not a FAM,the vm embeds the module instances
+#define INSTANCE_INLINE_SLOTS 4
+#define INSTANCE_INLINE_ENTRIES(instance)	((Entry*)((ObjInstance*)(instance) + 1))
+
 #define INVALID_OBJ_STRING_SYMBOL UINT32_MAX
 struct ObjString {
 	Obj obj;
@@ -118,13 +138,18 @@ struct ObjString {
 //begin at 8 and align to 8, when < 64,mul 2, then *1.5 and align 8
 //ARRAYLIKE_MAX + 7 & ~7 => ARRAYLIKE_MAX
 #define ARRAYLIKE_MAX 0xfffffff8
+//a literal keeps its elements in the block,a larger capacity moves them out
+#define ARRAY_INLINE_MIN 4
 typedef struct {
 	Obj obj;
 	uint32_t length;
 	uint32_t capacity;
 	Value* elements;
+	Value inlineElements[]; // flexible array members FAM
 } ObjArray;
 
+#define ARRAY_IS_INLINE(array)		((array)->elements == (array)->inlineElements)
+
 #define OBJ_GET_TYPE(obj)			((obj).type)
 #define OBJ_SET_TYPE(obj,objType)	((obj).type = objType)
 #define OBJ_PTR_GET_TYPE(obj)		((obj)->type)
@@ -138,6 +163,7 @@ typedef struct {
 #define IS_INSTANCE(value)			isObjType(value, OBJ_INSTANCE)
 #define IS_STRING(value)			isObjType(value, OBJ_STRING)
 #define IS_ARRAY(value)				isObjType(value, OBJ_ARRAY)
+#define IS_UPVALUE(value)			isObjType(value, OBJ_UPVALUE)
 
 #define OBJ_IS_TYPE(array, arrayType)		(OBJ_GET_TYPE(array->obj) == arrayType)
 #define ARRAY_IN_RANGE(array, index)		((index >= 0) && (index < array->length))
@@ -150,12 +176,15 @@ typedef struct {
 #define AS_NATIVE(value)			(((ObjNative*)AS_OBJ(value))->function)
 #define AS_STRING(value)			((ObjString*)AS_OBJ(value))
 #define AS_ARRAY(value)				((ObjArray*)AS_OBJ(value))
+#define AS_UPVALUE(value)			((ObjUpvalue*)AS_OBJ(value))
 
 static inline bool isObjType(Value value, ObjType type) {
 	return IS_OBJ(value) && AS_OBJ(value)->type == type;
 }
 
 ObjString* copyString(C_STR chars, uint32_t length, bool escapeChars);
+//the result is collectable,copyString is for the strings of the compiler and the vm
+ObjString* copyRuntimeString(C_STR chars, uint32_t length);
 ObjString* connectString(ObjString* strA, ObjString* strB);
 
 void printObject(Value value, bool isExpand);
@@ -170,6 +199,7 @@ ObjBoundMethod* newBoundMethod(Value receiver, ObjClosure* method);
 ObjNative* newNative(NativeFn function);
 ObjClass* newClass(ObjString* name);
 ObjInstance* newInstance(ObjClass* klass);
-ObjArray* newArray();
+//the elements up to the capacity are in the block
+ObjArray* newArray(uint32_t capacity);
 
-void reserveArray(ObjArray* array, uint64_t size);
\ No newline at end of file
+bool reserveArray(ObjArray* array, uint64_t size);
\ No newline at end of file
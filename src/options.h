@@ -15,14 +15,36 @@
 // log gc info
 #define DEBUG_LOG_GC 0
 
+// compile the bodies of global functions on their first call
+#define LAZY_COMPILE 0
+
+// interleave the major gc with the allocations
+#define GC_INCREMENTAL 0
+// the max pause of an incremental gc step in microseconds
+#define GC_MAX_PAUSE_US 1000
+// mark on a background thread instead of the incremental steps
+#define GC_CONCURRENT 0
+// threads of the stop-the-world gc,1 leaves the parallel gc out,--gc-threads changes it at runtime
+#define GC_THREADS 1
+// serve the small blocks from the size class slabs
+#define SLAB_ALLOCATOR 1
+// map the large buffers from the os directly and grow them in place
+#define LARGE_SPACE 1
+// free the vm by dropping its pages and buffer lists instead of every object
+#define VM_ARENAS 1
+// move the objects out of sparse pages after a major gc
+#define GC_COMPACT 0
+// record where the objects are allocated when --alloc-profile asks for it
+#define ALLOC_PROFILER 1
+
 // switch on this to use log
 #define LOG_MODE 0
 // use this to check memory allocate and leak
 #define LOG_EACH_MALLOC_INFO 0
 // use this to log gc info
 #define LOG_GC_RESULT 0
-// log memory info after execute
-#define LOG_MALLOC_INFO 1
+// log compile time and run time
+#define LOG_COMPILE_TIME 1
 
 #if !DEBUG_MODE
 #undef DEBUG_PRINT_CODE
@@ -31,8 +53,13 @@
 #undef DEBUG_LOG_GC
 #endif
 
+#if GC_CONCURRENT
+#undef GC_INCREMENTAL
+#define GC_INCREMENTAL 1
+#endif
+
 #if !LOG_MODE
 #undef LOG_EACH_MALLOC_INFO
 #undef LOG_GC_RESULT
-#undef LOG_MALLOC_INFO
+#undef LOG_COMPILE_TIME
 #endif
\ No newline at end of file
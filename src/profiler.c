@@ -0,0 +1,453 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#include "profiler.h"
+
+#if ALLOC_PROFILER
+#include "vm.h"
+#include "memory.h"
+#include "hash.h"
+
+//the frames without a function name,plain identifiers so pprof shows them as they are
+#define PROFILE_SCRIPT_NAME "script"
+#define PROFILE_COMPILER_NAME "compiler"
+
+//no padding,the frames are hashed as bytes
+typedef struct {
+	ObjFunction* function;
+	uint64_t line;
+} ProfileFrame;
+
+//the estimated allocations of one stack and type
+typedef struct {
+	uint64_t hash;
+	uint32_t frameBegin;
+	uint32_t depth;
+	ObjType type;
+	double count;
+	double bytes;
+} ProfileSite;
+
+int64_t profiler_countdown = INT64_MAX;
+
+static struct {
+	bool isOn;
+	uint64_t rate;
+	uint64_t random;
+
+	ProfileSite* sites;
+	uint32_t siteCount;
+	uint32_t siteCapacity;
+	//the index of a site + 1,0 is empty
+	uint32_t* slots;
+	uint32_t slotCapacity;
+
+	ProfileFrame* frames;
+	uint64_t frameCount;
+	uint64_t frameCapacity;
+} profiler = { .isOn = false };
+
+//xorshift64*,the profile is the same for the same run
+static inline double nextRandom() {
+	profiler.random ^= profiler.random >> 12;
+	profiler.random ^= profiler.random << 25;
+	profiler.random ^= profiler.random >> 27;
+	//53 bits in (0,1]
+	return (double)(((profiler.random * 0x2545F4914F6CDD1DULL) >> 11) + 1) / 9007199254740992.0;
+}
+
+//exponential with the mean of the rate,so a periodic allocation can't hide between the samples
+static inline int64_t nextInterval() {
+	if (profiler.rate == 0) return 0;
+	double interval = -log(nextRandom()) * (double)profiler.rate;
+	return (interval >= (double)INT64_MAX) ? INT64_MAX : (int64_t)interval;
+}
+
+void profiler_start(uint64_t rate)
+{
+	profiler_stop();
+	profiler.isOn = true;
+	profiler.rate = rate;
+	profiler.random = 0x9E3779B97F4A7C15ULL;
+	profiler_countdown = nextInterval();
+}
+
+void profiler_stop()
+{
+	profiler_countdown = INT64_MAX;
+	profiler.isOn = false;
+
+	mem_free(profiler.sites);
+	mem_free(profiler.slots);
+	mem_free(profiler.frames);
+	profiler.sites = NULL;
+	profiler.slots = NULL;
+	profiler.frames = NULL;
+	profiler.siteCount = 0;
+	profiler.siteCapacity = 0;
+	profiler.slotCapacity = 0;
+	profiler.frameCount = 0;
+	profiler.frameCapacity = 0;
+}
+
+bool profiler_isOn()
+{
+	return profiler.isOn;
+}
+
+static inline ProfileFrame frameAt(ObjFunction* function, uint8_t* ip, uint8_t* code) {
+	return (ProfileFrame) { .function = function, .line = getLine(&function->chunk.lines, (uint32_t)(ip - code - 1)) };
+}
+
+//from the outermost frame to the innermost,returns the depth
+static uint32_t captureStack(ProfileFrame frames[PROFILER_MAX_DEPTH]) {
+	//the compiler and the code between two scripts have no frame
+	if (vm.frameCount <= 0 || vm.ip_error == NULL) return 0;
+
+	uint32_t leaves = (vm.inlineFunction != NULL) ? 1 : 0;
+	int32_t first = vm.frameCount - (int32_t)(PROFILER_MAX_DEPTH - leaves);
+	if (first < 0) first = 0;
+
+	uint32_t depth = 0;
+	for (int32_t i = first; i < vm.frameCount; ++i) {
+		CallFrame* frame = &vm.frames[i];
+		ObjFunction* function = frame->closure->function;
+		uint8_t* ip = frame->ip;
+
+		//the running frame keeps its ip in the interpreter,unless a call is pushing the next one
+		if (i == vm.frameCount - 1) {
+			uint8_t* current = *vm.ip_error;
+			if (current > function->chunk.code && current <= function->chunk.code + function->chunk.count) {
+				ip = current;
+			}
+		}
+		frames[depth++] = frameAt(function, ip, function->chunk.code);
+	}
+
+	//the inlined body has the same layout as the function's code
+	if (leaves != 0) {
+		frames[depth++] = frameAt(vm.inlineFunction, *vm.ip_error, vm.inlineBegin);
+	}
+	return depth;
+}
+
+static uint32_t addSite(uint64_t hash, ProfileFrame* frames, uint32_t depth, ObjType type) {
+	if (profiler.frameCapacity < profiler.frameCount + depth) {
+		uint64_t capacity = GROW_CAPACITY(profiler.frameCapacity);
+		while (capacity < profiler.frameCount + depth) capacity *= 2;
+		ProfileFrame* grown = (ProfileFrame*)mem_realloc(profiler.frames, sizeof(ProfileFrame) * capacity);
+		if (grown == NULL) return UINT32_MAX;
+		profiler.frames = grown;
+		profiler.frameCapacity = capacity;
+	}
+	if (profiler.siteCapacity < profiler.siteCount + 1) {
+		uint32_t capacity = GROW_CAPACITY(profiler.siteCapacity);
+		ProfileSite* grown = (ProfileSite*)mem_realloc(profiler.sites, sizeof(ProfileSite) * capacity);
+		if (grown == NULL) return UINT32_MAX;
+		profiler.sites = grown;
+		profiler.siteCapacity = capacity;
+	}
+
+	if (depth > 0) {
+		memcpy(profiler.frames + profiler.frameCount, frames, sizeof(ProfileFrame) * depth);
+	}
+	profiler.sites[profiler.siteCount] = (ProfileSite){
+		.hash = hash,
+		.frameBegin = (uint32_t)profiler.frameCount,
+		.depth = depth,
+		.type = type,
+		.count = 0,
+		.bytes = 0,
+	};
+	profiler.frameCount += depth;
+	return profiler.siteCount++;
+}
+
+static bool growSlots() {
+	uint32_t capacity = (profiler.slotCapacity == 0) ? 64 : profiler.slotCapacity * 2;
+	uint32_t* slots = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+	if (slots == NULL) return false;
+
+	for (uint32_t i = 0; i < profiler.siteCount; ++i) {
+		uint32_t index = (uint32_t)profiler.sites[i].hash & (capacity - 1);
+		while (slots[index] != 0) index = (index + 1) & (capacity - 1);
+		slots[index] = i + 1;
+	}
+
+	mem_free(profiler.slots);
+	profiler.slots = slots;
+	profiler.slotCapacity = capacity;
+	return true;
+}
+
+static ProfileSite* findSite(ProfileFrame* frames, uint32_t depth, ObjType type) {
+	uint64_t hash = HASH_64bits(frames, sizeof(ProfileFrame) * depth) ^ ((uint64_t)type * 0x9E3779B97F4A7C15ULL);
+
+	//3/4 at most
+	if ((profiler.siteCount + 1) * 4 > profiler.slotCapacity * 3 && !growSlots()) return NULL;
+
+	uint32_t index = (uint32_t)hash & (profiler.slotCapacity - 1);
+	while (profiler.slots[index] != 0) {
+		ProfileSite* site = &profiler.sites[profiler.slots[index] - 1];
+		if (site->hash == hash && site->type == type && site->depth == depth
+			&& (depth == 0 || memcmp(profiler.frames + site->frameBegin, frames, sizeof(ProfileFrame) * depth) == 0)) {
+			return site;
+		}
+		index = (index + 1) & (profiler.slotCapacity - 1);
+	}
+
+	uint32_t site = addSite(hash, frames, depth, type);
+	if (site == UINT32_MAX) return NULL;
+	profiler.slots[index] = site + 1;
+	return &profiler.sites[site];
+}
+
+COLD_FUNCTION
+void profiler_sample(uint64_t size, ObjType type)
+{
+	profiler_countdown = nextInterval();
+
+	ProfileFrame frames[PROFILER_MAX_DEPTH];
+	uint32_t depth = captureStack(frames);
+	ProfileSite* site = findSite(frames, depth, type);
+	if (site == NULL) return;
+
+	//the chance of an allocation of this size to be sampled is 1 - e^(-size / rate)
+	double scale = 1.0;
+	if (profiler.rate != 0) {
+		scale = 1.0 / (1.0 - exp(-(double)size / (double)profiler.rate));
+	}
+	site->count += scale;
+	site->bytes += (double)size * scale;
+}
+
+static bool writeFolded(FILE* file) {
+	for (uint32_t i = 0; i < profiler.siteCount; ++i) {
+		ProfileSite* site = &profiler.sites[i];
+		ProfileFrame* frames = profiler.frames + site->frameBegin;
+
+		if (site->depth == 0) {
+			fprintf(file, PROFILE_COMPILER_NAME ";");
+		}
+		for (uint32_t j = 0; j < site->depth; ++j) {
+			ObjString* name = frames[j].function->name;
+			fprintf(file, "%s:%llu;", (name != NULL) ? name->chars : PROFILE_SCRIPT_NAME, (unsigned long long)frames[j].line);
+		}
+		fprintf(file, "%s %.0f\n", objTypeInfo[site->type], site->bytes);
+	}
+	return true;
+}
+
+//the protobuf of pprof,written without the gzip,which pprof accepts too
+typedef struct {
+	uint8_t* bytes;
+	uint64_t count;
+	uint64_t capacity;
+	bool failed;
+} ProtoBuffer;
+
+static void proto_append(ProtoBuffer* buffer, const void* data, uint64_t length) {
+	if (buffer->failed) return;
+	if (buffer->capacity < buffer->count + length) {
+		uint64_t capacity = (buffer->capacity == 0) ? 256 : buffer->capacity;
+		while (capacity < buffer->count + length) capacity *= 2;
+		uint8_t* bytes = (uint8_t*)mem_realloc(buffer->bytes, capacity);
+		if (bytes == NULL) {
+			buffer->failed = true;
+			return;
+		}
+		buffer->bytes = bytes;
+		buffer->capacity = capacity;
+	}
+	memcpy(buffer->bytes + buffer->count, data, length);
+	buffer->count += length;
+}
+
+static void proto_varint(ProtoBuffer* buffer, uint64_t value) {
+	uint8_t bytes[10];
+	uint32_t length = 0;
+	do {
+		bytes[length++] = (uint8_t)((value & 0x7f) | ((value > 0x7f) ? 0x80 : 0));
+		value >>= 7;
+	} while (value != 0);
+	proto_append(buffer, bytes, length);
+}
+
+static inline void proto_uint(ProtoBuffer* buffer, uint32_t field, uint64_t value) {
+	proto_varint(buffer, (uint64_t)field << 3);
+	proto_varint(buffer, value);
+}
+
+static inline void proto_bytes(ProtoBuffer* buffer, uint32_t field, const void* data, uint64_t length) {
+	proto_varint(buffer, ((uint64_t)field << 3) | 2);
+	proto_varint(buffer, length);
+	proto_append(buffer, data, length);
+}
+
+//moves the message into the buffer as a field
+static inline void proto_message(ProtoBuffer* buffer, uint32_t field, ProtoBuffer* message) {
+	proto_bytes(buffer, field, message->bytes, message->count);
+	buffer->failed |= message->failed;
+	message->count = 0;
+}
+
+//the ids of the functions and the locations,0 is empty
+typedef struct {
+	uint64_t a;
+	uint64_t b;
+	uint64_t id;
+} ProfileKey;
+
+typedef struct {
+	ProfileKey* keys;
+	uint64_t capacity;
+	uint64_t count;
+} ProfileIds;
+
+static uint64_t profileId(ProfileIds* ids, uint64_t a, uint64_t b, bool* isNew) {
+	uint64_t hash = (a * 0x9E3779B97F4A7C15ULL) ^ (b * 0xC2B2AE3D27D4EB4FULL);
+	uint64_t index = (hash ^ (hash >> 29)) & (ids->capacity - 1);
+
+	while (ids->keys[index].id != 0) {
+		if (ids->keys[index].a == a && ids->keys[index].b == b) {
+			*isNew = false;
+			return ids->keys[index].id;
+		}
+		index = (index + 1) & (ids->capacity - 1);
+	}
+
+	*isNew = true;
+	ids->keys[index] = (ProfileKey){ .a = a, .b = b, .id = ++ids->count };
+	return ids->count;
+}
+
+//the kinds of the function keys
+#define PROFILE_FUNCTION 0
+#define PROFILE_TYPE 1
+#define PROFILE_COMPILER 2
+
+typedef struct {
+	ProtoBuffer profile;
+	ProtoBuffer message;
+	ProtoBuffer line;
+	ProfileIds functions;
+	ProfileIds locations;
+	uint64_t stringCount;
+} PprofWriter;
+
+static uint64_t pprofString(PprofWriter* writer, C_STR string) {
+	proto_bytes(&writer->profile, 6, string, strlen(string));
+	return writer->stringCount++;
+}
+
+static uint64_t pprofLocation(PprofWriter* writer, uint64_t key, uint64_t kind, C_STR name, uint64_t line) {
+	bool isNew;
+	uint64_t function = profileId(&writer->functions, key, kind, &isNew);
+	if (isNew) {
+		uint64_t nameIndex = pprofString(writer, name);
+		proto_uint(&writer->message, 1, function);
+		proto_uint(&writer->message, 2, nameIndex);
+		proto_uint(&writer->message, 3, nameIndex);
+		proto_message(&writer->profile, 5, &writer->message);
+	}
+
+	uint64_t location = profileId(&writer->locations, function, line, &isNew);
+	if (isNew) {
+		proto_uint(&writer->line, 1, function);
+		proto_uint(&writer->line, 2, line);
+		proto_uint(&writer->message, 1, location);
+		proto_message(&writer->message, 4, &writer->line);
+		proto_message(&writer->profile, 4, &writer->message);
+	}
+	return location;
+}
+
+static bool writePprof(FILE* file) {
+	PprofWriter writer = { .stringCount = 0 };
+
+	//every frame may be a new function and location
+	uint64_t capacity = 64;
+	while (capacity < (profiler.frameCount + profiler.siteCount + OBJ_TYPE_COUNT + 1) * 2) capacity *= 2;
+	writer.functions = (ProfileIds){ .keys = (ProfileKey*)calloc(capacity, sizeof(ProfileKey)), .capacity = capacity };
+	writer.locations = (ProfileIds){ .keys = (ProfileKey*)calloc(capacity, sizeof(ProfileKey)), .capacity = capacity };
+	bool ok = (writer.functions.keys != NULL && writer.locations.keys != NULL);
+
+	if (ok) {
+		pprofString(&writer, "");
+		uint64_t objects = pprofString(&writer, "alloc_objects");
+		uint64_t count = pprofString(&writer, "count");
+		uint64_t space = pprofString(&writer, "alloc_space");
+		uint64_t bytes = pprofString(&writer, "bytes");
+
+		proto_uint(&writer.message, 1, objects);
+		proto_uint(&writer.message, 2, count);
+		proto_message(&writer.profile, 1, &writer.message);
+		proto_uint(&writer.message, 1, space);
+		proto_uint(&writer.message, 2, bytes);
+		proto_message(&writer.profile, 1, &writer.message);
+		//the period
+		proto_uint(&writer.message, 1, space);
+		proto_uint(&writer.message, 2, bytes);
+		proto_message(&writer.profile, 11, &writer.message);
+		proto_uint(&writer.profile, 12, profiler.rate);
+
+		ProtoBuffer ids = { 0 };
+		ProtoBuffer values = { 0 };
+		for (uint32_t i = 0; i < profiler.siteCount; ++i) {
+			ProfileSite* site = &profiler.sites[i];
+			ProfileFrame* frames = profiler.frames + site->frameBegin;
+
+			//the leaf is first,the type is a frame of its own like in the folded stacks
+			proto_varint(&ids, pprofLocation(&writer, site->type, PROFILE_TYPE, objTypeInfo[site->type], 0));
+			for (uint32_t j = site->depth; j-- > 0;) {
+				ObjString* name = frames[j].function->name;
+				proto_varint(&ids, pprofLocation(&writer, (uint64_t)(uintptr_t)frames[j].function, PROFILE_FUNCTION,
+					(name != NULL) ? name->chars : PROFILE_SCRIPT_NAME, frames[j].line));
+			}
+			if (site->depth == 0) {
+				proto_varint(&ids, pprofLocation(&writer, 0, PROFILE_COMPILER, PROFILE_COMPILER_NAME, 0));
+			}
+
+			proto_varint(&values, (uint64_t)llround(site->count));
+			proto_varint(&values, (uint64_t)llround(site->bytes));
+			proto_message(&writer.message, 1, &ids);
+			proto_message(&writer.message, 2, &values);
+			proto_message(&writer.profile, 2, &writer.message);
+		}
+		mem_free(ids.bytes);
+		mem_free(values.bytes);
+
+		ok = !writer.profile.failed && !writer.message.failed && !writer.line.failed
+			&& fwrite(writer.profile.bytes, 1, writer.profile.count, file) == writer.profile.count;
+	}
+
+	free(writer.functions.keys);
+	free(writer.locations.keys);
+	mem_free(writer.profile.bytes);
+	mem_free(writer.message.bytes);
+	mem_free(writer.line.bytes);
+	return ok;
+}
+
+static inline bool endsWith(C_STR string, C_STR suffix) {
+	uint64_t length = strlen(string);
+	uint64_t suffixLength = strlen(suffix);
+	return length >= suffixLength && strcmp(string + length - suffixLength, suffix) == 0;
+}
+
+COLD_FUNCTION
+bool profiler_write(C_STR path)
+{
+	if (!profiler.isOn) return false;
+
+	bool isPprof = endsWith(path, ".pb") || endsWith(path, ".pprof");
+	FILE* file = fopen(path, isPprof ? "wb" : "w");
+	if (file == NULL) return false;
+
+	bool ok = isPprof ? writePprof(file) : writeFolded(file);
+	ok = ok && !ferror(file);
+	return (fclose(file) == 0) && ok;
+}
+#endif
@@ -0,0 +1,37 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#pragma once
+#include "common.h"
+#include "object.h"
+
+#if ALLOC_PROFILER
+//the mean bytes between two samples
+#define PROFILER_SAMPLE_RATE (512 * 1024)
+//the frames kept from the top of a stack
+#define PROFILER_MAX_DEPTH 64
+
+//the bytes left before the next sample,INT64_MAX while it's off
+extern int64_t profiler_countdown;
+
+//rate is the mean bytes between two samples,0 records every allocation
+void profiler_start(uint64_t rate);
+void profiler_stop();
+bool profiler_isOn();
+//the countdown ran out,walk the frames and record the site
+void profiler_sample(uint64_t size, ObjType type);
+//a pprof protobuf for a path ending with .pb or .pprof,or else one folded stack for each site like "script:3;build:12;array 4096"
+//the counts and bytes are estimated from the samples
+bool profiler_write(C_STR path);
+
+//call it for each new object,only a subtraction while nothing is sampled
+static inline void profiler_count(uint64_t size, ObjType type) {
+	if ((profiler_countdown -= (int64_t)size) < 0) {
+		profiler_sample(size, type);
+	}
+}
+#else
+#define profiler_count(size, type) ((void)0)
+#endif
@@ -8,11 +8,11 @@
 //shared scanner
 Scanner scanner;
 
-void scanner_init(C_STR source)
+void scanner_init(C_STR source, uint32_t line)
 {
 	scanner.start = source;
 	scanner.current = source;
-	scanner.line = 1;
+	scanner.line = line;
 }
 
 static bool isAlpha(char c) {
@@ -148,7 +148,14 @@ static TokenType identifierType() {
 		if (scanner.current - scanner.start > 1) {
 			switch (scanner.start[1]) {
 			case 'l': return checkKeyword(2, 3, "ass", TOKEN_CLASS);
-			case 'o': return checkKeyword(2, 6, "ntinue", TOKEN_CONTINUE);
+			case 'o':
+				if (scanner.current - scanner.start > 3) {
+					switch (scanner.start[3]) {
+					case 's': return checkKeyword(2, 3, "nst", TOKEN_CONST);
+					case 't': return checkKeyword(2, 6, "ntinue", TOKEN_CONTINUE);
+					}
+				}
+				break;
 			}
 		}
 		break;
@@ -25,7 +25,7 @@ typedef enum {
 	// Builtin Literals. 
 	TOKEN_MODULE_ARRAY, TOKEN_MODULE_STRING, TOKEN_MODULE_SYSTEM,
 	// Keywords. 
-	TOKEN_AND, TOKEN_CLASS, TOKEN_FALSE,
+	TOKEN_AND, TOKEN_CLASS, TOKEN_CONST, TOKEN_FALSE,
 	TOKEN_FOR, TOKEN_FUN, TOKEN_NIL, TOKEN_OR,
 	TOKEN_RETURN, TOKEN_THIS,
 	TOKEN_TRUE, TOKEN_VAR,
@@ -48,6 +48,6 @@ typedef struct {
 	uint32_t line;
 } Token;
 
-void scanner_init(C_STR source);
+void scanner_init(C_STR source, uint32_t line);
 
 Token scanToken();
\ No newline at end of file
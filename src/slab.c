@@ -0,0 +1,286 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#if !defined(_WIN32)
+#define _DEFAULT_SOURCE
+#endif
+#include "slab.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#if GC_THREADS > 1
+#include <threads.h>
+#endif
+
+typedef struct SlabPage {
+	//the pages of a class with free blocks
+	struct SlabPage* prev;
+	struct SlabPage* next;
+	//the pages in use,full ones too
+	struct SlabPage* allPrev;
+	struct SlabPage* allNext;
+	//freed blocks,linked through their first word
+	void* freeList;
+	//blocks after it are never used
+	char* bump;
+	uint32_t used;
+	uint32_t capacity;
+	uint32_t classIndex;
+} SlabPage;
+
+#define SLAB_HEADER_SIZE ((sizeof(SlabPage) + 15) & ~(uint64_t)15)
+#define PAGE_OF(pointer) ((SlabPage*)((uintptr_t)(pointer) & ~(uintptr_t)(SLAB_PAGE_SIZE - 1)))
+
+static SlabPage* available[SLAB_CLASS_COUNT];
+static SlabPage* usedPages = NULL;
+static SlabPage* emptyPages = NULL;
+static uint32_t emptyCount = 0;
+static uint64_t pageCount = 0;
+
+#if GC_THREADS > 1
+static mtx_t slabLock;
+#endif
+
+//the pages are aligned to their size,so a block finds its page by masking
+void* slab_mapPages(uint64_t count)
+{
+	uint64_t size = SLAB_PAGE_SIZE * count;
+#if defined(_WIN32)
+	//the allocation granularity is 64kb
+	return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	//map one more page and trim it to an aligned range
+	char* raw = (char*)mmap(NULL, size + SLAB_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED) return NULL;
+
+	char* aligned = (char*)(((uintptr_t)raw + SLAB_PAGE_SIZE - 1) & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+	uint64_t head = aligned - raw;
+	if (head > 0) {
+		munmap(raw, head);
+	}
+	munmap(aligned + size, SLAB_PAGE_SIZE - head);
+	return aligned;
+#endif
+}
+
+void slab_unmapPages(void* pages, uint64_t count)
+{
+#if defined(_WIN32)
+	(void)count;
+	VirtualFree(pages, 0, MEM_RELEASE);
+#else
+	munmap(pages, SLAB_PAGE_SIZE * count);
+#endif
+}
+
+void* slab_mapPage()
+{
+	return slab_mapPages(1);
+}
+
+void slab_unmapPage(void* page)
+{
+	slab_unmapPages(page, 1);
+}
+
+static inline void linkPage(SlabPage* page) {
+	SlabPage** head = &available[page->classIndex];
+	page->prev = NULL;
+	page->next = *head;
+	if (*head != NULL) {
+		(*head)->prev = page;
+	}
+	*head = page;
+}
+
+static inline void unlinkPage(SlabPage* page) {
+	if (page->prev != NULL) {
+		page->prev->next = page->next;
+	}
+	else {
+		available[page->classIndex] = page->next;
+	}
+	if (page->next != NULL) {
+		page->next->prev = page->prev;
+	}
+}
+
+static inline void linkUsed(SlabPage* page) {
+	page->allPrev = NULL;
+	page->allNext = usedPages;
+	if (usedPages != NULL) {
+		usedPages->allPrev = page;
+	}
+	usedPages = page;
+}
+
+static inline void unlinkUsed(SlabPage* page) {
+	if (page->allPrev != NULL) {
+		page->allPrev->allNext = page->allNext;
+	}
+	else {
+		usedPages = page->allNext;
+	}
+	if (page->allNext != NULL) {
+		page->allNext->allPrev = page->allPrev;
+	}
+}
+
+COLD_FUNCTION
+static SlabPage* newPage(uint32_t classIndex) {
+	SlabPage* page = emptyPages;
+
+	if (page != NULL) {
+		emptyPages = page->next;
+		emptyCount--;
+	}
+	else {
+		page = (SlabPage*)slab_mapPage();
+		if (page == NULL) {
+			fprintf(stderr, "Memory reallocation failed!\n");
+			exit(1);
+		}
+		pageCount++;
+	}
+
+	page->freeList = NULL;
+	page->bump = (char*)page + SLAB_HEADER_SIZE;
+	page->used = 0;
+	page->capacity = (uint32_t)((SLAB_PAGE_SIZE - SLAB_HEADER_SIZE) / ((classIndex + 1) * SLAB_GRANULE));
+	page->classIndex = classIndex;
+	linkPage(page);
+	linkUsed(page);
+	return page;
+}
+
+static void retirePage(SlabPage* page) {
+	unlinkPage(page);
+	unlinkUsed(page);
+
+	if (emptyCount < SLAB_KEEP_PAGES) {
+		page->next = emptyPages;
+		emptyPages = page;
+		emptyCount++;
+	}
+	else {
+		slab_unmapPage(page);
+		pageCount--;
+	}
+}
+
+void slab_init()
+{
+	for (uint32_t i = 0; i < SLAB_CLASS_COUNT; ++i) {
+		available[i] = NULL;
+	}
+	usedPages = NULL;
+	emptyPages = NULL;
+	emptyCount = 0;
+	pageCount = 0;
+
+#if GC_THREADS > 1
+	mtx_init(&slabLock, mtx_plain);
+#endif
+}
+
+void slab_free()
+{
+	//the blocks still in use go with their pages
+	while (usedPages != NULL) {
+		SlabPage* page = usedPages;
+		usedPages = page->allNext;
+		slab_unmapPage(page);
+		pageCount--;
+	}
+	for (uint32_t i = 0; i < SLAB_CLASS_COUNT; ++i) {
+		available[i] = NULL;
+	}
+
+	while (emptyPages != NULL) {
+		SlabPage* page = emptyPages;
+		emptyPages = page->next;
+		slab_unmapPage(page);
+		pageCount--;
+	}
+	emptyCount = 0;
+
+#if GC_THREADS > 1
+	mtx_destroy(&slabLock);
+#endif
+}
+
+HOT_FUNCTION
+void* slab_allocBlock(uint64_t size)
+{
+	uint32_t classIndex = SLAB_CLASS(size);
+	SlabPage* page = available[classIndex];
+
+	if (page == NULL) {
+		page = newPage(classIndex);
+	}
+
+	void* block;
+	if (page->freeList != NULL) {
+		block = page->freeList;
+		page->freeList = *(void**)block;
+	}
+	else {
+		block = page->bump;
+		page->bump += (classIndex + 1) * SLAB_GRANULE;
+	}
+
+	//full pages leave the list until a block comes back
+	if (++page->used == page->capacity) {
+		unlinkPage(page);
+	}
+
+	return block;
+}
+
+HOT_FUNCTION
+void slab_freeBlock(void* pointer, uint64_t size)
+{
+	SlabPage* page = PAGE_OF(pointer);
+
+#if DEBUG_MODE
+	if (page->classIndex != SLAB_CLASS(size)) {
+		fprintf(stderr, "[slab] %p freed with size %llu but it is in class %u\n", pointer, (unsigned long long)size, page->classIndex);
+		exit(1);
+	}
+#endif
+
+	*(void**)pointer = page->freeList;
+	page->freeList = pointer;
+
+	if (page->used-- == page->capacity) {
+		linkPage(page);
+	}
+
+	if (page->used == 0) {
+		retirePage(page);
+	}
+}
+
+uint64_t slab_pageCount()
+{
+	return pageCount;
+}
+
+#if GC_THREADS > 1
+void slab_lock()
+{
+	mtx_lock(&slabLock);
+}
+
+void slab_unlock()
+{
+	mtx_unlock(&slabLock);
+}
+#endif
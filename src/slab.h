@@ -0,0 +1,45 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#pragma once
+#include "common.h"
+
+//the blocks of one size class share an aligned page
+#define SLAB_PAGE_SIZE (64 * 1024)
+//the size classes are multiples of it
+#define SLAB_GRANULE 8
+//larger blocks go to mem_realloc,an Entry array of 16 fits
+#define SLAB_MAX_SIZE 512
+#define SLAB_CLASS_COUNT (SLAB_MAX_SIZE / SLAB_GRANULE)
+//empty pages kept for reuse,the others go back to the os
+#define SLAB_KEEP_PAGES 8
+
+#define SLAB_FITS(size) ((size) <= SLAB_MAX_SIZE)
+#define SLAB_CLASS(size) ((uint32_t)(((size) + SLAB_GRANULE - 1) / SLAB_GRANULE) - 1)
+
+void slab_init();
+//release all pages,the blocks still in use too
+void slab_free();
+
+//size must be in (0,SLAB_MAX_SIZE]
+void* slab_allocBlock(uint64_t size);
+//size must be the one it was allocated with
+void slab_freeBlock(void* pointer, uint64_t size);
+
+//the pages mapped now
+uint64_t slab_pageCount();
+
+//an aligned page of SLAB_PAGE_SIZE from the os
+void* slab_mapPage();
+void slab_unmapPage(void* page);
+//count pages in one aligned range
+void* slab_mapPages(uint64_t count);
+void slab_unmapPages(void* pages, uint64_t count);
+
+#if GC_THREADS > 1
+//the sweeping threads free blocks at the same time
+void slab_lock();
+void slab_unlock();
+#endif
@@ -0,0 +1,678 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#include "snapshot.h"
+#include "object.h"
+#include "vm.h"
+#include "gc.h"
+#include "heap.h"
+
+static inline void writeU8(FILE* file, uint8_t value) {
+	fputc(value, file);
+}
+
+static inline void writeU16(FILE* file, uint16_t value) {
+	fwrite(&value, sizeof(value), 1, file);
+}
+
+static inline void writeU32(FILE* file, uint32_t value) {
+	fwrite(&value, sizeof(value), 1, file);
+}
+
+static inline void writeU64(FILE* file, uint64_t value) {
+	fwrite(&value, sizeof(value), 1, file);
+}
+
+//no file only counts it
+static inline uint32_t edge(FILE* file, Obj* target) {
+	if (target == NULL) return 0;
+	if (file != NULL) writeU64(file, (uint64_t)(uintptr_t)target);
+	return 1;
+}
+
+static inline uint32_t valueEdge(FILE* file, Value value) {
+	return IS_OBJ(value) ? edge(file, AS_OBJ(value)) : 0;
+}
+
+static uint32_t tableEdges(FILE* file, Table* table) {
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < table->used; i++) {
+		Entry* entry = &table->entries[i];
+		//a deleted entry has no key
+		if (entry->key == NULL) continue;
+		count += edge(file, (Obj*)entry->key);
+		count += valueEdge(file, entry->value);
+	}
+	return count;
+}
+
+//the same references the gc follows,and the static objects too
+static uint32_t objectEdges(FILE* file, Obj* object) {
+	switch (object->type) {
+	case OBJ_FUNCTION:
+		return edge(file, (Obj*)((ObjFunction*)object)->name);
+	case OBJ_UPVALUE:
+		//the open one points into the stack,which is a root anyway
+		return valueEdge(file, *((ObjUpvalue*)object)->location);
+	case OBJ_CLOSURE: {
+		ObjClosure* closure = (ObjClosure*)object;
+		uint32_t count = edge(file, (Obj*)closure->function);
+		for (uint32_t i = 0; i < closure->upvalueCount; i++) {
+			count += valueEdge(file, closure->upvalues[i]);
+		}
+		return count;
+	}
+	case OBJ_BOUND_METHOD: {
+		ObjBoundMethod* bound = (ObjBoundMethod*)object;
+		return valueEdge(file, bound->receiver) + edge(file, (Obj*)bound->method);
+	}
+	case OBJ_CLASS: {
+		ObjClass* klass = (ObjClass*)object;
+		return edge(file, (Obj*)klass->name) + valueEdge(file, klass->initializer) + tableEdges(file, &klass->methods);
+	}
+	case OBJ_INSTANCE: {
+		ObjInstance* instance = (ObjInstance*)object;
+		return edge(file, (Obj*)instance->klass) + edge(file, (Obj*)instance->bound) + tableEdges(file, &instance->fields);
+	}
+	case OBJ_ARRAY: {
+		ObjArray* array = (ObjArray*)object;
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < array->length; i++) {
+			count += valueEdge(file, array->elements[i]);
+		}
+		return count;
+	}
+	default:
+		return 0;
+	}
+}
+
+//the name shown by the analyzer
+static ObjString* objectLabel(Obj* object) {
+	switch (object->type) {
+	case OBJ_FUNCTION:
+		return ((ObjFunction*)object)->name;
+	case OBJ_CLOSURE:
+		return ((ObjClosure*)object)->function->name;
+	case OBJ_BOUND_METHOD:
+		return ((ObjBoundMethod*)object)->method->function->name;
+	case OBJ_CLASS:
+		return ((ObjClass*)object)->name;
+	case OBJ_INSTANCE: {
+		ObjClass* klass = ((ObjInstance*)object)->klass;
+		return (klass != NULL) ? klass->name : NULL;
+	}
+	default:
+		return NULL;
+	}
+}
+
+static void writeObject(FILE* file, Obj* object) {
+	uint64_t bytes = objectBytes(object);
+	uint64_t buffers = objectBufferBytes(object);
+
+	writeU8(file, 'o');
+	writeU64(file, (uint64_t)(uintptr_t)object);
+	writeU8(file, object->type);
+	writeU32(file, (bytes > UINT32_MAX) ? UINT32_MAX : (uint32_t)bytes);
+	writeU32(file, (buffers > UINT32_MAX) ? UINT32_MAX : (uint32_t)buffers);
+	writeU64(file, (uint64_t)(uintptr_t)objectLabel(object));
+
+	//count them first,so nothing is buffered
+	writeU32(file, objectEdges(NULL, object));
+	objectEdges(file, object);
+
+	if (object->type == OBJ_STRING) {
+		ObjString* string = (ObjString*)object;
+		writeU32(file, string->length);
+		fwrite(string->chars, 1, string->length, file);
+	}
+}
+
+static inline void writeRoot(FILE* file, SnapshotRoot kind, Obj* object, ObjString* name) {
+	if (object == NULL) return;
+	writeU8(file, 'r');
+	writeU8(file, (uint8_t)kind);
+	writeU64(file, (uint64_t)(uintptr_t)object);
+	writeU64(file, (uint64_t)(uintptr_t)name);
+}
+
+static void writeRoots(FILE* file) {
+	for (Value* slot = vm.stack; slot < vm.stackTop; slot++) {
+		if (IS_OBJ(*slot)) writeRoot(file, SNAPSHOT_ROOT_STACK, AS_OBJ(*slot), NULL);
+	}
+
+	for (int32_t i = 0; i < vm.frameCount; i++) {
+		writeRoot(file, SNAPSHOT_ROOT_FRAME, (Obj*)vm.frames[i].closure, NULL);
+	}
+
+	for (ObjUpvalue* upvalue = vm.openUpvalues; upvalue != NULL; upvalue = upvalue->next) {
+		writeRoot(file, SNAPSHOT_ROOT_UPVALUE, (Obj*)upvalue, NULL);
+	}
+
+	Table* globals = &vm.globals.fields;
+	for (uint32_t i = 0; i < globals->used; i++) {
+		Entry* entry = &globals->entries[i];
+		if (entry->key != NULL && IS_OBJ(entry->value)) {
+			writeRoot(file, SNAPSHOT_ROOT_GLOBAL, AS_OBJ(entry->value), entry->key);
+		}
+	}
+
+	for (uint32_t i = 0; i < vm.constGlobalCount; i++) {
+		ConstGlobal* global = &vm.constGlobals[i];
+		if (IS_OBJ(global->value)) {
+			writeRoot(file, SNAPSHOT_ROOT_CONST, AS_OBJ(global->value), global->name);
+		}
+	}
+
+	for (uint64_t i = 0; i < vm.staticCount; ++i) {
+		writeRoot(file, SNAPSHOT_ROOT_STATIC, vm.staticObjects[i], NULL);
+	}
+
+	//the pool is weak,only the pinned strings are held by it
+	Table* strings = &vm.strings;
+	for (uint32_t i = 0; i < strings->used; i++) {
+		Entry* entry = &strings->entries[i];
+		if (entry->key != NULL && !entry->key->obj.isStatic && IS_BOOL(entry->value) && AS_BOOL(entry->value)) {
+			writeRoot(file, SNAPSHOT_ROOT_POOL, (Obj*)entry->key, NULL);
+		}
+	}
+
+	for (uint32_t module = 0; module < BUILTIN_MODULE_COUNT; module++) {
+		Table* fields = &vm.builtins[module].fields;
+		for (uint32_t i = 0; i < fields->used; i++) {
+			Entry* entry = &fields->entries[i];
+			if (entry->key != NULL && IS_OBJ(entry->value)) {
+				writeRoot(file, SNAPSHOT_ROOT_MODULE, AS_OBJ(entry->value), entry->key);
+			}
+		}
+	}
+}
+
+COLD_FUNCTION
+bool snapshot_write(C_STR path)
+{
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) return false;
+
+	//the dead objects would only be noise
+	garbageCollect();
+	waitForGC();
+
+	//the objects go out one by one,the buffer of the file is all it needs
+	fwrite(SNAPSHOT_MAGIC, 1, sizeof(SNAPSHOT_MAGIC) - 1, file);
+	writeU16(file, SNAPSHOT_VERSION);
+
+	uint64_t count = 0;
+	for (HeapPage* page = vm.pages; page != NULL; page = page->allNext) {
+		uint32_t words = heap_wordCount(page);
+
+		for (uint32_t i = 0; i < words; ++i) {
+			uint64_t bits = page->allocBits[i] & heap_validBits(page, i);
+
+			for (; bits != 0; bits &= bits - 1) {
+				writeObject(file, heap_blockAt(page, (i << 6) + heap_ctz(bits)));
+				++count;
+			}
+		}
+	}
+
+	for (uint64_t i = 0; i < vm.staticCount; ++i) {
+		writeObject(file, vm.staticObjects[i]);
+		++count;
+	}
+
+	writeRoots(file);
+	writeU8(file, 'e');
+	writeU64(file, count);
+
+	bool ok = !ferror(file);
+	return (fclose(file) == 0) && ok;
+}
+
+#if defined(SNAPSHOT_SIGNAL)
+volatile sig_atomic_t snapshot_requested = 0;
+
+static void onSnapshotSignal(int number) {
+	(void)number;
+	snapshot_requested = 1;
+}
+
+COLD_FUNCTION
+void snapshot_installSignal()
+{
+	snapshot_requested = 0;
+	signal(SNAPSHOT_SIGNAL, onSnapshotSignal);
+}
+
+COLD_FUNCTION
+void snapshot_writeRequested()
+{
+	static uint32_t index = 0;
+	char path[64];
+
+	snapshot_requested = 0;
+	//some platforms reset the handler when it runs
+	signal(SNAPSHOT_SIGNAL, onSnapshotSignal);
+	snprintf(path, sizeof(path), "flite-%u.heapsnapshot", index++);
+
+	if (snapshot_write(path)) {
+		fprintf(stderr, "[snapshot] %s\n", path);
+	}
+	else {
+		fprintf(stderr, "Could not write the heap snapshot \"%s\".\n", path);
+	}
+}
+#endif
+
+//the analyzer doesn't need a vm,it reads the whole file
+typedef struct {
+	uint64_t id;
+	uint64_t label;
+	uint64_t size;
+	uint32_t edgeBegin;
+	uint32_t edgeCount;
+	//the chars of a string,in the file buffer
+	uint64_t stringOffset;
+	uint32_t stringLength;
+	uint8_t type;
+} SnapshotNode;
+
+typedef struct {
+	const uint8_t* data;
+	uint64_t size;
+	uint64_t offset;
+	bool failed;
+} SnapshotReader;
+
+static inline const uint8_t* readRaw(SnapshotReader* reader, uint64_t size) {
+	if (reader->failed || reader->size - reader->offset < size) {
+		reader->failed = true;
+		return NULL;
+	}
+	const uint8_t* bytes = reader->data + reader->offset;
+	reader->offset += size;
+	return bytes;
+}
+
+#define READ_TYPE(type) \
+	static inline type read_##type(SnapshotReader* reader) { \
+		const uint8_t* bytes = readRaw(reader, sizeof(type)); \
+		type value = 0; \
+		if (bytes != NULL) memcpy(&value, bytes, sizeof(type)); \
+		return value; \
+	}
+
+READ_TYPE(uint8_t)
+READ_TYPE(uint16_t)
+READ_TYPE(uint32_t)
+READ_TYPE(uint64_t)
+#undef READ_TYPE
+
+typedef struct {
+	uint64_t id;
+	uint32_t index;
+} SnapshotIndex;
+
+static int compareIndex(const void* a, const void* b) {
+	uint64_t idA = ((const SnapshotIndex*)a)->id;
+	uint64_t idB = ((const SnapshotIndex*)b)->id;
+	return (idA < idB) ? -1 : (idA > idB);
+}
+
+//0 is the super root,so it means not found
+static uint32_t findNode(SnapshotIndex* indices, uint32_t count, uint64_t id) {
+	uint32_t low = 0;
+	uint32_t high = count;
+	while (low < high) {
+		uint32_t middle = low + ((high - low) >> 1);
+		if (indices[middle].id < id) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return (low < count && indices[low].id == id) ? indices[low].index : 0;
+}
+
+typedef struct {
+	uint32_t* postorder;
+	uint32_t* idom;
+	uint64_t* retained;
+} Dominators;
+
+//the arrays of the analyzer,out of memory ends it like a failed reallocate
+static void* analyzerAlloc(void* pointer) {
+	if (pointer == NULL) {
+		fprintf(stderr, "Memory reallocation failed!\n");
+		exit(1);
+	}
+	return pointer;
+}
+
+static uint32_t intersect(uint32_t* idom, uint32_t* number, uint32_t a, uint32_t b) {
+	while (a != b) {
+		while (number[a] < number[b]) a = idom[a];
+		while (number[b] < number[a]) b = idom[b];
+	}
+	return a;
+}
+
+//the iterative algorithm of cooper,harvey and kennedy,returns the reachable count
+static uint32_t computeDominators(SnapshotNode* nodes, uint32_t count, uint32_t* edges, Dominators* result) {
+	const uint32_t none = UINT32_MAX;
+	uint32_t* number = (uint32_t*)analyzerAlloc(malloc(sizeof(uint32_t) * count));
+	uint32_t* stack = (uint32_t*)analyzerAlloc(malloc(sizeof(uint32_t) * count));
+	uint32_t* next = (uint32_t*)analyzerAlloc(malloc(sizeof(uint32_t) * count));
+	uint32_t* postorder = result->postorder;
+	uint32_t* idom = result->idom;
+
+	for (uint32_t i = 0; i < count; ++i) {
+		number[i] = none;
+		idom[i] = none;
+	}
+
+	//number them in postorder,the root gets the highest
+	uint32_t reached = 0;
+	uint32_t depth = 0;
+	stack[depth++] = 0;
+	next[0] = 0;
+	number[0] = 0;
+	while (depth > 0) {
+		uint32_t node = stack[depth - 1];
+		if (next[node] < nodes[node].edgeCount) {
+			uint32_t target = edges[nodes[node].edgeBegin + next[node]++];
+			if (number[target] == none) {
+				number[target] = 0;
+				next[target] = 0;
+				stack[depth++] = target;
+			}
+		}
+		else {
+			number[node] = reached;
+			postorder[reached++] = node;
+			--depth;
+		}
+	}
+
+	//the predecessors of the reachable nodes
+	uint32_t* predBegin = (uint32_t*)analyzerAlloc(calloc((uint64_t)count + 1, sizeof(uint32_t)));
+	for (uint32_t node = 0; node < count; ++node) {
+		if (number[node] == none) continue;
+		for (uint32_t i = 0; i < nodes[node].edgeCount; ++i) {
+			predBegin[edges[nodes[node].edgeBegin + i] + 1]++;
+		}
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		predBegin[i + 1] += predBegin[i];
+	}
+	uint32_t* preds = (uint32_t*)analyzerAlloc(malloc(sizeof(uint32_t) * ((uint64_t)predBegin[count] + 1)));
+	memcpy(next, predBegin, sizeof(uint32_t) * count);
+	for (uint32_t node = 0; node < count; ++node) {
+		if (number[node] == none) continue;
+		for (uint32_t i = 0; i < nodes[node].edgeCount; ++i) {
+			uint32_t target = edges[nodes[node].edgeBegin + i];
+			preds[next[target]++] = node;
+		}
+	}
+
+	idom[0] = 0;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		//reverse postorder,the root is skipped
+		for (uint32_t i = reached - 1; i-- > 0;) {
+			uint32_t node = postorder[i];
+			uint32_t dominator = none;
+
+			for (uint32_t p = predBegin[node]; p < predBegin[node + 1]; ++p) {
+				uint32_t pred = preds[p];
+				if (idom[pred] == none) continue;
+				dominator = (dominator == none) ? pred : intersect(idom, number, pred, dominator);
+			}
+
+			if (idom[node] != dominator) {
+				idom[node] = dominator;
+				changed = true;
+			}
+		}
+	}
+
+	//the children come first in postorder
+	for (uint32_t i = 0; i < count; ++i) {
+		result->retained[i] = nodes[i].size;
+	}
+	for (uint32_t i = 0; i + 1 < reached; ++i) {
+		uint32_t node = postorder[i];
+		result->retained[idom[node]] += result->retained[node];
+	}
+
+	free(preds);
+	free(predBegin);
+	free(next);
+	free(stack);
+	free(number);
+	return reached;
+}
+
+static void printLabel(const uint8_t* data, SnapshotNode* nodes, SnapshotIndex* indices, uint32_t count, SnapshotNode* node) {
+	SnapshotNode* string = node;
+	if (node->type != OBJ_STRING) {
+		uint32_t index = (node->label != 0) ? findNode(indices, count - 1, node->label) : 0;
+		if (index == 0) return;
+		string = &nodes[index];
+	}
+
+	uint32_t length = (string->stringLength > 40) ? 40 : string->stringLength;
+	printf(" %s%.*s%s", (node->type == OBJ_STRING) ? "\"" : "", (int)length,
+		(const char*)data + string->stringOffset, (length < string->stringLength) ? "..." : ((node->type == OBJ_STRING) ? "\"" : ""));
+}
+
+static int compareRetained(const void* a, const void* b) {
+	uint64_t sizeA = *(const uint64_t*)a;
+	uint64_t sizeB = *(const uint64_t*)b;
+	return (sizeA > sizeB) ? -1 : (sizeA < sizeB);
+}
+
+#define SNAPSHOT_TOP_COUNT 20
+
+COLD_FUNCTION
+bool snapshot_analyze(C_STR path)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Could not open file \"%s\".\n", path);
+		return false;
+	}
+
+	fseek(file, 0L, SEEK_END);
+	uint64_t fileSize = ftell(file);
+	rewind(file);
+
+	uint8_t* data = (uint8_t*)malloc(fileSize + 1);
+	if (data == NULL || fread(data, 1, fileSize, file) < fileSize) {
+		fprintf(stderr, "Could not read file \"%s\".\n", path);
+		fclose(file);
+		free(data);
+		return false;
+	}
+	fclose(file);
+
+	SnapshotReader reader = { .data = data, .size = fileSize, .offset = 0, .failed = false };
+	const uint8_t* magic = readRaw(&reader, sizeof(SNAPSHOT_MAGIC) - 1);
+	if (magic == NULL || memcmp(magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC) - 1) != 0 || read_uint16_t(&reader) != SNAPSHOT_VERSION) {
+		fprintf(stderr, "\"%s\" is not a heap snapshot.\n", path);
+		free(data);
+		return false;
+	}
+	uint64_t begin = reader.offset;
+
+	//count them first,then fill the arrays
+	uint64_t objectCount = 0;
+	uint64_t rootCount = 0;
+	uint64_t edgeCount = 0;
+	bool ended = false;
+	while (!ended && !reader.failed) {
+		switch (read_uint8_t(&reader)) {
+		case 'o': {
+			readRaw(&reader, 8);
+			uint8_t type = read_uint8_t(&reader);
+			readRaw(&reader, 4 + 4 + 8);
+			uint32_t edges = read_uint32_t(&reader);
+			readRaw(&reader, (uint64_t)edges * 8);
+			if (type == OBJ_STRING) {
+				readRaw(&reader, read_uint32_t(&reader));
+			}
+			if (type >= OBJ_TYPE_COUNT) reader.failed = true;
+			edgeCount += edges;
+			++objectCount;
+			break;
+		}
+		case 'r':
+			readRaw(&reader, 1 + 8 + 8);
+			++rootCount;
+			break;
+		case 'e':
+			ended = (read_uint64_t(&reader) == objectCount);
+			if (!ended) reader.failed = true;
+			break;
+		default:
+			reader.failed = true;
+			break;
+		}
+	}
+
+	if (reader.failed || objectCount + 1 > UINT32_MAX || edgeCount + rootCount > UINT32_MAX) {
+		fprintf(stderr, "The heap snapshot \"%s\" is broken.\n", path);
+		free(data);
+		return false;
+	}
+
+	uint32_t count = (uint32_t)objectCount + 1;
+	SnapshotNode* nodes = (SnapshotNode*)analyzerAlloc(calloc(count, sizeof(SnapshotNode)));
+	SnapshotIndex* indices = (SnapshotIndex*)analyzerAlloc(malloc(sizeof(SnapshotIndex) * count));
+	uint64_t* rawEdges = (uint64_t*)analyzerAlloc(malloc(sizeof(uint64_t) * (edgeCount + rootCount + 1)));
+	uint32_t* edges = (uint32_t*)analyzerAlloc(malloc(sizeof(uint32_t) * (edgeCount + rootCount + 1)));
+	uint64_t rootSizes[SNAPSHOT_ROOT_COUNT] = { 0 };
+
+	//the super root is 0,its edges are the roots,they come last in the file
+	reader.offset = begin;
+	uint32_t edgeIndex = (uint32_t)rootCount;
+	uint32_t rootIndex = 0;
+	uint32_t nodeIndex = 1;
+	nodes[0].edgeBegin = 0;
+	nodes[0].edgeCount = (uint32_t)rootCount;
+	nodes[0].type = OBJ_TYPE_COUNT;
+
+	for (uint8_t tag = read_uint8_t(&reader); tag != 'e'; tag = read_uint8_t(&reader)) {
+		if (tag == 'r') {
+			uint8_t kind = read_uint8_t(&reader);
+			rawEdges[rootIndex++] = read_uint64_t(&reader);
+			read_uint64_t(&reader);
+			if (kind < SNAPSHOT_ROOT_COUNT) rootSizes[kind]++;
+			continue;
+		}
+
+		SnapshotNode* node = &nodes[nodeIndex];
+		node->id = read_uint64_t(&reader);
+		node->type = read_uint8_t(&reader);
+		node->size = read_uint32_t(&reader);
+		node->size += read_uint32_t(&reader);
+		node->label = read_uint64_t(&reader);
+		node->edgeCount = read_uint32_t(&reader);
+		node->edgeBegin = edgeIndex;
+		for (uint32_t i = 0; i < node->edgeCount; ++i) {
+			rawEdges[edgeIndex++] = read_uint64_t(&reader);
+		}
+		if (node->type == OBJ_STRING) {
+			node->stringLength = read_uint32_t(&reader);
+			node->stringOffset = reader.offset;
+			readRaw(&reader, node->stringLength);
+		}
+
+		indices[nodeIndex - 1] = (SnapshotIndex){ .id = node->id, .index = nodeIndex };
+		++nodeIndex;
+	}
+
+	qsort(indices, count - 1, sizeof(SnapshotIndex), compareIndex);
+
+	//an edge to a thing that isn't an object (a module of the vm) points at the root,which is harmless
+	uint64_t totalBytes = 0;
+	for (uint32_t node = 0; node < count; ++node) {
+		totalBytes += nodes[node].size;
+		for (uint32_t i = 0; i < nodes[node].edgeCount; ++i) {
+			uint32_t index = nodes[node].edgeBegin + i;
+			edges[index] = findNode(indices, count - 1, rawEdges[index]);
+		}
+	}
+	free(rawEdges);
+
+	Dominators dominators = {
+		.postorder = (uint32_t*)analyzerAlloc(malloc(sizeof(uint32_t) * count)),
+		.idom = (uint32_t*)analyzerAlloc(malloc(sizeof(uint32_t) * count)),
+		.retained = (uint64_t*)analyzerAlloc(malloc(sizeof(uint64_t) * count)),
+	};
+	uint32_t reached = computeDominators(nodes, count, edges, &dominators);
+
+	printf("objects : %u, %llu bytes, %u unreachable\n", count - 1, (unsigned long long)totalBytes, count - reached);
+	printf("roots   : %llu stack, %llu frame, %llu upvalue, %llu global, %llu const, %llu static, %llu pool, %llu module\n",
+		(unsigned long long)rootSizes[SNAPSHOT_ROOT_STACK], (unsigned long long)rootSizes[SNAPSHOT_ROOT_FRAME],
+		(unsigned long long)rootSizes[SNAPSHOT_ROOT_UPVALUE], (unsigned long long)rootSizes[SNAPSHOT_ROOT_GLOBAL],
+		(unsigned long long)rootSizes[SNAPSHOT_ROOT_CONST], (unsigned long long)rootSizes[SNAPSHOT_ROOT_STATIC],
+		(unsigned long long)rootSizes[SNAPSHOT_ROOT_POOL], (unsigned long long)rootSizes[SNAPSHOT_ROOT_MODULE]);
+
+	printf("\n%-12s %10s %12s\n", "type", "count", "bytes");
+	for (uint32_t type = 0; type < OBJ_TYPE_COUNT; ++type) {
+		uint64_t typeCount = 0;
+		uint64_t typeBytes = 0;
+		for (uint32_t node = 1; node < count; ++node) {
+			if (nodes[node].type != type) continue;
+			typeCount++;
+			typeBytes += nodes[node].size;
+		}
+		if (typeCount > 0) {
+			printf("%-12s %10llu %12llu\n", objTypeInfo[type], (unsigned long long)typeCount, (unsigned long long)typeBytes);
+		}
+	}
+
+	//sort the retained sizes with the node index next to them
+	uint64_t* order = (uint64_t*)analyzerAlloc(malloc(sizeof(uint64_t) * 2 * count));
+	uint32_t ordered = 0;
+	for (uint32_t node = 1; node < count; ++node) {
+		if (dominators.idom[node] == UINT32_MAX) continue;
+		order[ordered * 2] = dominators.retained[node];
+		order[ordered * 2 + 1] = node;
+		++ordered;
+	}
+	qsort(order, ordered, sizeof(uint64_t) * 2, compareRetained);
+
+	printf("\n%12s %10s %-12s %-18s %s\n", "retained", "self", "type", "id", "dominator");
+	for (uint32_t i = 0; i < ordered && i < SNAPSHOT_TOP_COUNT; ++i) {
+		SnapshotNode* node = &nodes[order[i * 2 + 1]];
+		uint32_t dominator = dominators.idom[order[i * 2 + 1]];
+
+		printf("%12llu %10llu %-12s 0x%016llx ", (unsigned long long)order[i * 2], (unsigned long long)node->size,
+			objTypeInfo[node->type], (unsigned long long)node->id);
+		if (dominator == 0) {
+			printf("root");
+		}
+		else {
+			printf("0x%016llx", (unsigned long long)nodes[dominator].id);
+		}
+		printLabel(data, nodes, indices, count, node);
+		printf("\n");
+	}
+
+	free(order);
+	free(dominators.retained);
+	free(dominators.idom);
+	free(dominators.postorder);
+	free(edges);
+	free(indices);
+	free(nodes);
+	free(data);
+	return true;
+}
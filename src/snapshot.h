@@ -0,0 +1,54 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#pragma once
+#include "common.h"
+#include <signal.h>
+
+/*
+* the heap snapshot file,in the byte order of the machine that wrote it
+* header : "FLSNAP" u16 version
+* object : 'o' u64 id, u8 type, u32 bytes, u32 buffers, u64 label, u32 edgeCount, u64 edges[edgeCount]
+*          a string is followed by u32 length and the chars
+* root   : 'r' u8 kind, u64 id, u64 name
+* end    : 'e' u64 objectCount
+* the ids are the addresses,a label or a name is the id of a string or 0
+*/
+#define SNAPSHOT_MAGIC "FLSNAP"
+#define SNAPSHOT_VERSION 1
+
+typedef enum {
+	SNAPSHOT_ROOT_STACK,
+	SNAPSHOT_ROOT_FRAME,
+	SNAPSHOT_ROOT_UPVALUE,
+	SNAPSHOT_ROOT_GLOBAL,
+	SNAPSHOT_ROOT_CONST,
+	//the objects that never die,the strings pinned in the pool and the natives of the modules
+	SNAPSHOT_ROOT_STATIC,
+	SNAPSHOT_ROOT_POOL,
+	SNAPSHOT_ROOT_MODULE,
+
+	SNAPSHOT_ROOT_COUNT
+} SnapshotRoot;
+
+//the signal that asks for a snapshot,none on the platforms without one
+#if defined(SIGUSR1)
+#define SNAPSHOT_SIGNAL SIGUSR1
+#elif defined(SIGBREAK)
+#define SNAPSHOT_SIGNAL SIGBREAK
+#endif
+
+#if defined(SNAPSHOT_SIGNAL)
+//set by the handler,the interpreter writes the snapshot at the next safe point
+extern volatile sig_atomic_t snapshot_requested;
+void snapshot_installSignal();
+//a file named flite-<n>.heapsnapshot in the working directory
+void snapshot_writeRequested();
+#endif
+
+//runs a full gc first,so only the live objects are written,returns false if the file can't be written
+bool snapshot_write(C_STR path);
+//print the dominators with the largest retained sizes,returns false for a bad file
+bool snapshot_analyze(C_STR path);
@@ -7,100 +7,312 @@
 #include "object.h"
 #include "table.h"
 #include "hash.h"
+#include "heap.h"
 #include "gc.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TABLE_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define TABLE_NEON 1
+#endif
+
 #define TABLE_MAX_LOAD 0.75 // 3/4
 #define MUL_3_DIV_4(x) ((x) * 3 / 4)
 
+//a full slot keeps the low 7 bits of the hash,the free ones have the high bit
+#define CTRL_EMPTY ((uint8_t)0x80)
+#define CTRL_DELETED ((uint8_t)0xFE)
+#define HASH_H1(hash) ((uint32_t)((hash) >> 7))
+#define HASH_H2(hash) ((uint8_t)((hash) & 0x7F))
+
+#define NO_SLOT UINT32_MAX
+//the index of the slots follows the dense entries,then the control bytes
+#define INDEX_OF(entries, capacity) ((void*)((entries) + TABLE_USABLE(capacity)))
+#define CONTROL(entries, capacity) ((uint8_t*)INDEX_OF(entries, capacity) + (uint64_t)(capacity) * TABLE_INDEX_WIDTH(capacity))
+//small tables grow one step at a time,the inline fields of an instance go to 8 slots
+#define TABLE_MIN_CAPACITY 8
+#define TABLE_GROW_CAPACITY(capacity) ((capacity) < TABLE_MIN_CAPACITY ? TABLE_MIN_CAPACITY : (capacity) << 1)
+//the deleted entries,each one holds at most one tombstone in the control bytes
+#define TABLE_DELETED(table) ((table)->used - (table)->count)
+//less than 1/4 of the entries in use,a table shrinks until it's between 1/4 and 1/2
+#define TABLE_BELOW_LOW_WATER(count, capacity) ((uint64_t)(count) * 4 < TABLE_USABLE((uint64_t)(capacity)))
+
+//a bit for each matched byte of a group,the index is the bit >> GROUP_SHIFT
+typedef uint64_t GroupMask;
+
+#if TABLE_SSE2
+#define GROUP_SHIFT 0
+typedef __m128i Group;
+
+static inline Group groupLoad(const uint8_t* control) {
+	return _mm_loadu_si128((const __m128i*)control);
+}
+
+static inline GroupMask groupMatch(Group group, uint8_t h2) {
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+}
+
+//empty or deleted
+static inline GroupMask groupMatchFree(Group group) {
+	return (uint32_t)_mm_movemask_epi8(group);
+}
+#elif TABLE_NEON
+#define GROUP_SHIFT 2
+typedef uint8x16_t Group;
+
+static inline Group groupLoad(const uint8_t* control) {
+	return vld1q_u8(control);
+}
+
+//no movemask,narrow each byte to a nibble and keep one bit of it
+static inline GroupMask groupBits(uint8x16_t matched) {
+	uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(matched), 4);
+	return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & 0x8888888888888888ull;
+}
+
+static inline GroupMask groupMatch(Group group, uint8_t h2) {
+	return groupBits(vceqq_u8(group, vdupq_n_u8(h2)));
+}
+
+static inline GroupMask groupMatchFree(Group group) {
+	return groupBits(vtstq_u8(group, vdupq_n_u8(0x80)));
+}
+#else
+#define GROUP_SHIFT 0
+typedef const uint8_t* Group;
+
+static inline Group groupLoad(const uint8_t* control) {
+	return control;
+}
+
+static inline GroupMask groupMatch(Group group, uint8_t h2) {
+	GroupMask mask = 0;
+	for (uint32_t i = 0; i < TABLE_GROUP_WIDTH; ++i) {
+		mask |= (GroupMask)(group[i] == h2) << i;
+	}
+	return mask;
+}
+
+static inline GroupMask groupMatchFree(Group group) {
+	GroupMask mask = 0;
+	for (uint32_t i = 0; i < TABLE_GROUP_WIDTH; ++i) {
+		mask |= (GroupMask)(group[i] >> 7) << i;
+	}
+	return mask;
+}
+#endif
+
+static inline GroupMask groupMatchEmpty(Group group) {
+	return groupMatch(group, CTRL_EMPTY);
+}
+
+static inline uint32_t groupIndex(GroupMask mask) {
+	return heap_ctz(mask) >> GROUP_SHIFT;
+}
+
+//the index is a byte for a small table,the width grows with it
+static inline uint32_t getIndex(void* index, uint32_t capacity, uint32_t slot) {
+	if (capacity <= 256) return ((uint8_t*)index)[slot];
+	if (capacity <= 65536) return ((uint16_t*)index)[slot];
+	return ((uint32_t*)index)[slot];
+}
+
+static inline void setIndex(void* index, uint32_t capacity, uint32_t slot, uint32_t entry) {
+	if (capacity <= 256) ((uint8_t*)index)[slot] = (uint8_t)entry;
+	else if (capacity <= 65536) ((uint16_t*)index)[slot] = (uint16_t)entry;
+	else ((uint32_t*)index)[slot] = entry;
+}
+
+//a group starting near the end reads the copies after it,a small table repeats itself there
+static inline void setControl(uint8_t* control, uint32_t capacity, uint32_t slot, uint8_t h2) {
+	control[slot] = h2;
+	for (uint32_t i = capacity + slot; i < capacity + TABLE_GROUP_WIDTH - 1; i += capacity) {
+		control[i] = h2;
+	}
+}
+
+static void initStorage(Entry* entries, uint32_t capacity) {
+	for (uint32_t i = 0; i < TABLE_USABLE(capacity); ++i) {
+		entries[i].key = NULL;
+		entries[i].value = NIL_VAL;
+	}
+	memset(CONTROL(entries, capacity), CTRL_EMPTY, capacity + TABLE_GROUP_WIDTH - 1);
+}
+
+static void freeStorage(Table* table) {
+	//the inline storage stays with the object
+	if (table->type == TABLE_INLINE) {
+		table->type = TABLE_NORMAL;
+	}
+	else if (table->entries != NULL) {
+		reallocate(table->entries, TABLE_STORAGE_SIZE(table->capacity), 0);
+	}
+}
+
 void table_init(Table* table)
 {
-	table->inlineCaching = 0;
+	table->used = 0;
 	table->count = 0;
 	table->capacity = 0;
 	table->entries = NULL;
 }
 
+void table_initInline(Table* table, Entry* entries, uint32_t capacity)
+{
+	table->type = TABLE_INLINE;
+	table->used = 0;
+	table->count = 0;
+	table->capacity = capacity;
+	table->entries = entries;
+
+	initStorage(entries, capacity);
+}
+
 void table_free(Table* table)
 {
-	FREE_ARRAY(Entry, table->entries, table->capacity);
+	freeStorage(table);
 	table_init(table);
 }
 
+//returns the entry of the key and puts its slot in the index,the groups are visited in triangular steps,that reaches all of them in a power of 2 table
 HOT_FUNCTION
-static Entry* findEntry(Entry* entries, uint32_t capacity, ObjString* key, TableType type) {
-	//check it
-	Entry* entry = NULL;
+static inline uint32_t findEntry(Table* table, ObjString* key, uint32_t* slot) {
+	Entry* entries = table->entries;
+	uint32_t capacity = table->capacity;
+	void* index = INDEX_OF(entries, capacity);
+	uint8_t* control = CONTROL(entries, capacity);
+	uint32_t mask = capacity - 1;
+	uint32_t position = HASH_H1(key->hash) & mask;
+	uint8_t h2 = HASH_H2(key->hash);
+
+	for (uint32_t step = TABLE_GROUP_WIDTH; ; step += TABLE_GROUP_WIDTH) {
+		Group group = groupLoad(control + position);
+
+		for (GroupMask match = groupMatch(group, h2); match != 0; match &= match - 1) {
+			*slot = (position + groupIndex(match)) & mask;
+			uint32_t entry = getIndex(index, capacity, *slot);
+			if (entries[entry].key == key) return entry;
+		}
 
-	uint32_t index = key->hash & (capacity - 1);
-	Entry* tombstone = NULL;
+		//a probe for the key would have stopped here
+		if (groupMatchEmpty(group) != 0) return NO_SLOT;
 
-	while (true) {
-		entry = &entries[index];
+		position = (position + step) & mask;
+	}
+}
 
-		if (entry->key == NULL) {
-			if (IS_NIL(entry->value)) {
-				//only for global
-				if (type == TABLE_GLOBAL) {
-					key->symbol = index;
-				}
-				// if we find hole after tombstone ,it means the tombstone is target else return the hole
-				// Empty entry.
-				return tombstone != NULL ? tombstone : entry;
-			}
-			else {
-				// We found a tombstone.
-				if (tombstone == NULL) tombstone = entry;
-			}
-		}
-		else if (entry->key == key) {
-			//only for global
-			if (type == TABLE_GLOBAL) {
-				key->symbol = index;
-			}
-			// We found the key.
-			return entry;
-		}
+//the first empty or deleted slot of the probe
+static uint32_t findFree(uint8_t* control, uint32_t capacity, uint64_t hash) {
+	uint32_t mask = capacity - 1;
+	uint32_t position = HASH_H1(hash) & mask;
 
-		index = (index + 1) & (capacity - 1);
+	for (uint32_t step = TABLE_GROUP_WIDTH; ; step += TABLE_GROUP_WIDTH) {
+		GroupMask free = groupMatchFree(groupLoad(control + position));
+		if (free != 0) return (position + groupIndex(free)) & mask;
+
+		position = (position + step) & mask;
 	}
 }
 
-static void adjustCapacity(Table* table, uint32_t capacity) {
-	//we need re input, so don't reallocate
-	Entry* entries = ALLOCATE(Entry, capacity);
+//no group around the slot was ever without an empty one,so no probe went past it and it can be empty again
+static bool wasNeverFull(uint8_t* control, uint32_t capacity, uint32_t slot) {
+	//one group reads all slots of a small table
+	if (capacity < TABLE_GROUP_WIDTH) return true;
 
-	for (uint32_t i = 0; i < capacity; ++i) {
-		entries[i].key = NULL;
-		entries[i].value = NIL_VAL;
+	uint32_t mask = capacity - 1;
+	uint32_t after = 0;
+	uint32_t before = 0;
+
+	while (after < TABLE_GROUP_WIDTH && control[(slot + after) & mask] != CTRL_EMPTY) after++;
+	while (before < TABLE_GROUP_WIDTH && control[(slot - 1 - before) & mask] != CTRL_EMPTY) before++;
+
+	return (after + before) < TABLE_GROUP_WIDTH;
+}
+
+//put the entry in the next dense one and point a free slot at it
+static inline uint32_t appendEntry(Table* table, ObjString* key, Value value) {
+	uint32_t capacity = table->capacity;
+	uint8_t* control = CONTROL(table->entries, capacity);
+	uint32_t slot = findFree(control, capacity, key->hash);
+	uint32_t entry = table->used++;
+
+	setControl(control, capacity, slot, HASH_H2(key->hash));
+	setIndex(INDEX_OF(table->entries, capacity), capacity, slot, entry);
+	table->entries[entry].key = key;
+	table->entries[entry].value = value;
+	table->count++;
+
+	//only for global
+	if (table->type == TABLE_GLOBAL) {
+		key->symbol = entry;
 	}
 
-	table->count = 0;
+	return entry;
+}
 
-	for (uint32_t i = 0; i < table->capacity; ++i) {
+//the live entries are packed in their order and the deleted ones dropped
+static void adjustCapacity(Table* table, uint32_t capacity) {
+	Table resized = { .type = (table->type == TABLE_INLINE) ? TABLE_NORMAL : table->type };
+	resized.capacity = capacity;
+	//we need re input, so don't reallocate
+	resized.entries = (Entry*)reallocate(NULL, 0, TABLE_STORAGE_SIZE(capacity));
+	initStorage(resized.entries, capacity);
+
+	for (uint32_t i = 0; i < table->used; ++i) {
 		Entry* entry = &table->entries[i];
 		if (entry->key == NULL) continue;
 
-		Entry* dest = findEntry(entries, capacity, entry->key, table->type);
-		dest->key = entry->key;
-		dest->value = entry->value;
-
-		table->count++;
+		//the keys are unique,no need to look for them
+		appendEntry(&resized, entry->key, entry->value);
 	}
 
-	FREE_ARRAY(Entry, table->entries, table->capacity);
+	//the marking thread may be reading the old entries
+	bool locked = gcLockBuffers();
+	freeStorage(table);
+	*table = resized;
+	gcUnlockBuffers(locked);
+}
 
-	table->entries = entries;
-	table->capacity = capacity;
+//the same storage,the live entries move down over the deleted ones and the slots are filled again
+static void rehashInPlace(Table* table) {
+	Entry* entries = table->entries;
+	uint32_t used = table->used;
+
+	//the marking thread may be walking the entries
+	bool locked = gcLockBuffers();
+	memset(CONTROL(entries, table->capacity), CTRL_EMPTY, table->capacity + TABLE_GROUP_WIDTH - 1);
+	table->used = 0;
+	table->count = 0;
+
+	for (uint32_t i = 0; i < used; ++i) {
+		Entry entry = entries[i];
+		entries[i].key = NULL;
+		entries[i].value = NIL_VAL;
+
+		//lands at i or before
+		if (entry.key != NULL) {
+			appendEntry(table, entry.key, entry.value);
+		}
+	}
+	gcUnlockBuffers(locked);
 }
 
 HOT_FUNCTION
 bool tableGet(Table* table, ObjString* key, Value* value) {
 	if (table->count == 0) return false;
 
-	Entry* entry = findEntry(table->entries, table->capacity, key, table->type);
-	if (entry->key == NULL) return false;
+	uint32_t slot;
+	uint32_t entry = findEntry(table, key, &slot);
+	if (entry == NO_SLOT) return false;
 
-	*value = entry->value;
+	//only for global
+	if (table->type == TABLE_GLOBAL) {
+		key->symbol = entry;
+	}
+
+	*value = table->entries[entry].value;
 	return true;
 }
 
@@ -109,19 +321,53 @@ bool tableSet(Table* table, ObjString* key, Value value)
 {
 	if (table->type == TABLE_MODULE) return false;// not allowed
 
-	//if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
-	if ((table->count + 1) > MUL_3_DIV_4((uint64_t)(table->capacity))) {
-		uint32_t capacity = GROW_CAPACITY(table->capacity);
-		adjustCapacity(table, capacity);
+	if (table->count != 0) {
+		uint32_t slot;
+		uint32_t entry = findEntry(table, key, &slot);
+
+		if (entry != NO_SLOT) {
+			//only for global
+			if (table->type == TABLE_GLOBAL) {
+				key->symbol = entry;
+			}
+
+			storeValue(&table->entries[entry].value, value);
+			return false;
+		}
 	}
 
-	Entry* entry = findEntry(table->entries, table->capacity, key, table->type);
-	bool isNewKey = entry->key == NULL;
-	if (isNewKey && IS_NIL(entry->value)) table->count++;
+	//the entries are all taken,pack them again in place if the deleted ones are the most
+	if (table->used == TABLE_USABLE(table->capacity)) {
+		if (TABLE_DELETED(table) > table->count) {
+			rehashInPlace(table);
+		}
+		else {
+			adjustCapacity(table, TABLE_GROW_CAPACITY(table->capacity));
+		}
+	}
 
-	entry->key = key;
-	entry->value = value;
-	return isNewKey;
+	//the marking thread may be walking the entries
+	bool locked = gcLockBuffers();
+	appendEntry(table, key, value);
+	gcUnlockBuffers(locked);
+	return true;
+}
+
+void tableReserve(Table* table, uint32_t extra)
+{
+	if ((table->used + (uint64_t)extra) > TABLE_USABLE((uint64_t)table->capacity)) {
+		//the deleted entries make the room
+		if ((table->count + (uint64_t)extra) <= TABLE_USABLE((uint64_t)table->capacity)) {
+			rehashInPlace(table);
+			return;
+		}
+
+		uint32_t capacity = TABLE_GROW_CAPACITY(table->capacity);
+		while ((table->count + (uint64_t)extra) > TABLE_USABLE((uint64_t)capacity)) {
+			capacity = TABLE_GROW_CAPACITY(capacity);
+		}
+		adjustCapacity(table, capacity);
+	}
 }
 
 HOT_FUNCTION
@@ -131,18 +377,40 @@ bool tableDelete(Table* table, ObjString* key) {
 	if (table->count == 0) return false;
 
 	// Find the entry.
-	Entry* entry = findEntry(table->entries, table->capacity, key, table->type);
-	if (entry->key == NULL) return false;
+	uint32_t slot;
+	uint32_t entry = findEntry(table, key, &slot);
+	if (entry == NO_SLOT) return false;
+
+	uint8_t* control = CONTROL(table->entries, table->capacity);
+	// Place a tombstone in the slot,unless no probe went past it.
+	setControl(control, table->capacity, slot, wasNeverFull(control, table->capacity, slot) ? CTRL_EMPTY : CTRL_DELETED);
+
+	//the entry stays taken until the table is packed,so a slot is only deleted once for each entry
+	bool locked = gcLockBuffers();
+	table->entries[entry].key = NULL;
+	table->entries[entry].value = NIL_VAL;
+	gcUnlockBuffers(locked);
+	table->count--;
+
+	//only for global
+	if (table->type == TABLE_GLOBAL) {
+		key->symbol = INVALID_OBJ_STRING_SYMBOL;
+	}
 
-	// Place a tombstone in the entry. 
-	entry->key = NULL;
-	entry->value = BOOL_VAL(true);//value of tombstone is true
+	//few entries are left,give the slots back
+	if (table->type != TABLE_POOL && table->capacity > TABLE_MIN_CAPACITY && TABLE_BELOW_LOW_WATER(table->count, table->capacity)) {
+		uint32_t capacity = table->capacity >> 1;
+		while (capacity > TABLE_MIN_CAPACITY && TABLE_BELOW_LOW_WATER(table->count, capacity)) {
+			capacity >>= 1;
+		}
+		adjustCapacity(table, capacity);
+	}
 	return true;
 }
 
 void tableAddAll(Table* from, Table* to)
 {
-	for (uint32_t i = 0; i < from->capacity; ++i) {
+	for (uint32_t i = 0; i < from->used; ++i) {
 		Entry* entry = &from->entries[i];
 		if (entry->key != NULL) {
 			tableSet(to, entry->key, entry->value);
@@ -154,22 +422,32 @@ ObjString* tableFindString(Table* table, C_STR chars, uint32_t length, uint64_t
 {
 	if (table->count == 0) return NULL;
 
-	uint32_t index = hash & (table->capacity - 1);
-
-	while (true) {
-		Entry* entry = &table->entries[index];
-		if (entry->key == NULL) {
-			// Stop if we find an empty non-tombstone entry.
-			if (IS_NIL(entry->value)) return NULL;
-		}
-		else if (entry->key->length == length &&
-			entry->key->hash == hash &&
-			memcmp(entry->key->chars, chars, length) == 0) {
-			// We found it.
-			return entry->key;
+	Entry* entries = table->entries;
+	uint32_t capacity = table->capacity;
+	void* index = INDEX_OF(entries, capacity);
+	uint8_t* control = CONTROL(entries, capacity);
+	uint32_t mask = capacity - 1;
+	uint32_t position = HASH_H1(hash) & mask;
+	uint8_t h2 = HASH_H2(hash);
+
+	for (uint32_t step = TABLE_GROUP_WIDTH; ; step += TABLE_GROUP_WIDTH) {
+		Group group = groupLoad(control + position);
+
+		for (GroupMask match = groupMatch(group, h2); match != 0; match &= match - 1) {
+			ObjString* key = entries[getIndex(index, capacity, (position + groupIndex(match)) & mask)].key;
+
+			if (key->length == length &&
+				key->hash == hash &&
+				memcmp(key->chars, chars, length) == 0) {
+				// We found it.
+				return key;
+			}
 		}
 
-		index = (index + 1) & (table->capacity - 1);
+		// Stop if we find an empty non-tombstone entry.
+		if (groupMatchEmpty(group) != 0) return NULL;
+
+		position = (position + step) & mask;
 	}
 }
 
@@ -183,34 +461,23 @@ ObjString* tableFindString(Table* table, C_STR chars, uint32_t length, uint64_t
 //	}
 //}
 
+//only the entries taken,the deleted ones are null and nil
 void markTable(Table* table) {
-	for (uint32_t i = 0; i < table->capacity; i++) {
+	for (uint32_t i = 0; i < table->used; i++) {
 		Entry* entry = &table->entries[i];
-		//markObject((Obj*)entry->key);
+		//the runtime strings can be keys
+		markObject((Obj*)entry->key);
 		markValue(entry->value);
 	}
 }
 
 Entry* tableGetStringEntry(Table* table, ObjString* key)
 {
-	//check it
-	Entry* entry = NULL;
-
-	uint32_t index = key->hash & (table->capacity - 1);
-
-	while (true) {
-		entry = &table->entries[index];
-
-		if (entry->key == key) {
-			return entry;
-		}
-		else if (entry->key == NULL) {
-			// Stop if we find an empty non-tombstone entry.
-			if (IS_NIL(entry->value)) return NULL;
-		}
+	if (table->count == 0) return NULL;
 
-		index = (index + 1) & (table->capacity - 1);
-	}
+	uint32_t slot;
+	uint32_t entry = findEntry(table, key, &slot);
+	return (entry == NO_SLOT) ? NULL : &table->entries[entry];
 }
 
 void numberTable_init(NumberTable* table)
@@ -22,15 +22,27 @@ typedef struct {
 typedef enum {
 	TABLE_NORMAL,
 	TABLE_GLOBAL,
-	TABLE_MODULE
+	TABLE_MODULE,
+	TABLE_POOL, //normal,but the gc deletes from it while walking the entries,so it never shrinks
+	TABLE_INLINE //normal,but the entries are in the block of its object until it grows
 } TableType;
 
+//the control bytes are read a group at a time
+#define TABLE_GROUP_WIDTH 16
+//the entries a capacity holds,7/8 of the slots and at least one slot stays empty to end the probes
+#define TABLE_USABLE(capacity) ((capacity) == 0 ? 0 : (capacity) - ((capacity) >= 16 ? (capacity) >> 3 : 1))
+//the bytes of a slot of the index,enough to point at any entry
+#define TABLE_INDEX_WIDTH(capacity) ((capacity) <= 256 ? 1 : ((capacity) <= 65536 ? 2 : 4))
+//one block holds the dense entries,the index,a control byte for each slot and the copies of the first ones a group can read past the end
+#define TABLE_STORAGE_SIZE(capacity) ((capacity) == 0 ? 0 : \
+	(((uint64_t)TABLE_USABLE(capacity) * sizeof(Entry) + (uint64_t)(capacity) * (TABLE_INDEX_WIDTH(capacity) + 1) + TABLE_GROUP_WIDTH - 1 + 7) & ~(uint64_t)7))
+
 typedef struct {
 	TableType type;
-	uint32_t inlineCaching; //cache offset
-	uint32_t count;
-	uint32_t capacity;
-	Entry* entries;
+	uint32_t used;//the entries taken,the deleted ones too
+	uint32_t count;//the live entries
+	uint32_t capacity;//the slots of the index
+	Entry* entries;//in insertion order,a deleted one has no key,the index and the control bytes follow them
 } Table;
 
 typedef struct {
@@ -40,11 +52,16 @@ typedef struct {
 } NumberTable;
 
 void table_init(Table* table);
+//start with the storage the owner holds,TABLE_STORAGE_SIZE(capacity) bytes,the capacity is a power of 2
+void table_initInline(Table* table, Entry* entries, uint32_t capacity);
 void table_free(Table* table);
 
 bool tableGet(Table* table, ObjString* key, Value* value);
 bool tableSet(Table* table, ObjString* key, Value value);
 bool tableDelete(Table* table, ObjString* key);
+//the next extra new keys won't grow the table
+void tableReserve(Table* table, uint32_t extra);
+//in the order they were added
 void tableAddAll(Table* from, Table* to);
 
 ObjString* tableFindString(Table* table, C_STR chars,uint32_t length, uint64_t hash);
@@ -0,0 +1,37 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 199309L
+#endif
+#include "timer.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+uint64_t timer_nanos()
+{
+#if defined(_WIN32)
+	static LARGE_INTEGER frequency = { 0 };
+	if (frequency.QuadPart == 0) {
+		QueryPerformanceFrequency(&frequency);
+	}
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	//split it,the counter times a billion overflows after some days
+	uint64_t seconds = (uint64_t)counter.QuadPart / (uint64_t)frequency.QuadPart;
+	uint64_t rest = (uint64_t)counter.QuadPart % (uint64_t)frequency.QuadPart;
+	return seconds * TIMER_NANOS_PER_SECOND + rest * TIMER_NANOS_PER_SECOND / (uint64_t)frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * TIMER_NANOS_PER_SECOND + (uint64_t)now.tv_nsec;
+#endif
+}
@@ -0,0 +1,13 @@
+/*
+ * MIT License
+ * Copyright (c) 2025 IMSDcrueoft (https://github.com/IMSDcrueoft)
+ * See LICENSE file in the root directory for full license text.
+*/
+#pragma once
+#include "common.h"
+
+#define TIMER_NANOS_PER_MICRO 1000
+#define TIMER_NANOS_PER_SECOND 1000000000
+
+//a monotonic wall clock in nanoseconds,clock() counts the cpu time of every thread and ticks by the millisecond on msvc
+uint64_t timer_nanos();
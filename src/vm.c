@@ -6,6 +6,9 @@
 #include "vm.h"
 #include "object.h"
 #include "gc.h"
+#include "slab.h"
+#include "arena.h"
+#include "snapshot.h"
 #include <time.h>
 
 #if DEBUG_TRACE_EXECUTION
@@ -41,6 +44,10 @@ static void stack_reset()
 
 	vm.frameCount = 0;
 	vm.openUpvalues = NULL;
+
+	vm.inlineFunction = NULL;
+	vm.inlineBegin = NULL;
+	vm.inlineSlots = NULL;
 }
 
 COLD_FUNCTION
@@ -57,6 +64,15 @@ static void runtimeError(C_STR format, ...) {
 		vm.frames[vm.frameCount - 1].ip = *vm.ip_error;
 	}
 
+	//the inlined body has the same layout as the function's code
+	if (vm.inlineFunction != NULL) {
+		ObjFunction* function = vm.inlineFunction;
+		uint64_t instruction = *vm.ip_error - vm.inlineBegin - 1;
+		uint32_t line = getLine(&function->chunk.lines, (uint32_t)instruction);
+
+		fprintf(stderr, "[line %d] in %s() : (%d) (inlined)\n", line, function->name->chars, function->id);
+	}
+
 	for (int32_t i = vm.frameCount - 1; i >= 0; i--) {
 		CallFrame* frame = &vm.frames[i];
 		ObjFunction* function = frame->closure->function;
@@ -76,6 +92,12 @@ static void runtimeError(C_STR format, ...) {
 	stack_reset();
 }
 
+COLD_FUNCTION
+static void heapLimitError() {
+	vm.heapExhausted = false;
+	runtimeError("Heap limit of %llu bytes exceeded.", (unsigned long long)gcPolicy.heapLimit);
+}
+
 HOT_FUNCTION
 void stack_push(Value value)
 {
@@ -199,6 +221,12 @@ static void initTypeStrings() {
 COLD_FUNCTION
 void vm_init()
 {
+#if SLAB_ALLOCATOR
+	slab_init();
+#endif
+#if VM_ARENAS
+	arena_init();
+#endif
 	vm.stack = NULL;
 	vm.stackTop = NULL;
 	vm.stackBoundary = NULL;
@@ -219,22 +247,55 @@ void vm_init()
 	table_init(&vm.globals.fields);
 
 	table_init(&vm.strings);
-	vm.strings.type = TABLE_NORMAL;
+	vm.strings.type = TABLE_POOL;
 	numberTable_init(&vm.numbers);
 
-	vm.objects = NULL;
-	vm.objects_no_gc = NULL;
+	table_init(&vm.constGlobalSlots);
+	vm.constGlobalSlots.type = TABLE_NORMAL;
+	vm.constGlobalCount = 0;
+	vm.constGlobalCapacity = 0;
+	vm.constGlobals = NULL;
+
+	heap_init();
+	gcStats = (GCStats){ 0 };
+#if defined(SNAPSHOT_SIGNAL)
+	snapshot_installSignal();
+#endif
+	vm.staticCount = 0;
+	vm.staticCapacity = 0;
+	vm.staticObjects = NULL;
 
 	//init gray stack
 	vm.grayCount = 0;
 	vm.grayCapacity = 0;
 	vm.grayStack = NULL;
 
+	vm.rememberedCount = 0;
+	vm.rememberedCapacity = 0;
+	vm.rememberedSet = NULL;
+	vm.youngStringCount = 0;
+	vm.youngStringCapacity = 0;
+	vm.youngStrings = NULL;
+
+	vm.overwrittenCount = 0;
+	vm.overwrittenCapacity = 0;
+	vm.overwrittenSet = NULL;
+
 	vm.functionID = 0;
 	//set
 	vm.bytesAllocated = 0;
 	vm.bytesAllocated_no_gc = 0;
-	vm.nextGC = GC_HEAP_BEGIN;
+	vm.nextGC = gcPolicy.heapBegin;
+	vm.nextMinorGC = GC_NURSERY_SIZE;
+#if LARGE_SPACE
+	vm.nextLargeGC = GC_LARGE_BEGIN;
+#endif
+	vm.lastGCStep = 0;
+	vm.nextGCStep = 0;
+#if GC_COMPACT
+	vm.compactPending = false;
+#endif
+	vm.heapExhausted = false;
 
 	//import the builtins
 	importBuiltins();
@@ -266,6 +327,12 @@ void vm_free()
 	table_free(&vm.strings);
 	numberTable_free(&vm.numbers);
 
+	table_free(&vm.constGlobalSlots);
+	FREE_ARRAY_NO_GC(ConstGlobal, vm.constGlobals, vm.constGlobalCapacity);
+	vm.constGlobals = NULL;
+	vm.constGlobalCount = 0;
+	vm.constGlobalCapacity = 0;
+
 	vm.initString = NULL;
 	for (uint32_t i = 0; i < TYPE_STRING_COUNT; ++i) {
 		vm.typeStrings[i] = NULL;
@@ -284,6 +351,7 @@ void vm_free()
 
 	vm.ip_error = NULL;
 	table_free(&vm.emptyClass.methods);
+	freeBuffers();
 }
 
 uint32_t getConstantSize()
@@ -341,8 +409,33 @@ static void getTypeof() {
 	stack_replace(NIL_VAL);
 }
 
+#if LAZY_COMPILE
+COLD_FUNCTION
+static bool compileOnCall(ObjFunction* function) {
+#if LOG_COMPILE_TIME
+	clock_t start = clock();
+#endif
+	bool success = compileLazy(function);
+#if LOG_COMPILE_TIME
+	vm.lazyCompileTime += (double)(clock() - start) / CLOCKS_PER_SEC;
+#endif
+
+	if (!success) {
+		runtimeError("Failed to compile function '%s'.", function->name->chars);
+	}
+	return success;
+}
+#endif
+
 HOT_FUNCTION
 static bool call(ObjClosure* closure, int argCount) {
+#if LAZY_COMPILE
+	//the body is compiled on the first call
+	if (closure->function->lazy != NULL && !compileOnCall(closure->function)) {
+		return false;
+	}
+#endif
+
 	if (argCount > closure->function->arity) {
 		runtimeError("Expected %d arguments but got %d.",
 			closure->function->arity, argCount);
@@ -372,6 +465,11 @@ static bool call_native(NativeFn native, int argCount) {
 	Value* stackTop = vm.stackTop - argCount;//store top, we don't know if native push stack (avoiding gc)
 	Value result = native(argCount, stackTop);
 	vm.stackTop = stackTop;//restore the top
+	//a native must not go on over the heap limit
+	if (vm.heapExhausted) {
+		heapLimitError();
+		return false;
+	}
 	stack_replace(result);
 	return true;
 }
@@ -380,10 +478,13 @@ static inline void defineMethod(ObjString* name) {
 	Value method = vm.stackTop[-1];
 	ObjClass* klass = AS_CLASS(vm.stackTop[-2]);
 
+	tableOverwriteBarrier(&klass->methods, name);
 	tableSet(&klass->methods, name, method);
 	if (name == vm.initString) {//inline cache
-		klass->initializer = method;
+		overwriteBarrier(klass->initializer);
+		storeValue(&klass->initializer, method);
 	}
+	writeBarrier(&klass->obj, method);
 	vm.stackTop--;
 }
 
@@ -448,10 +549,21 @@ static inline bool invoke(ObjString* name, int argCount) {
 }
 
 HOT_FUNCTION
-static void bindMethod(ObjClass* klass, ObjString* name) {
+static void bindMethod(ObjInstance* instance, ObjString* name) {
 	Value method;
-	if (tableGet(&klass->methods, name, &method)) {
-		ObjBoundMethod* bound = newBoundMethod(vm.stackTop[-1], AS_CLOSURE(method));
+	if (tableGet(&instance->klass->methods, name, &method)) {
+		ObjClosure* closure = AS_CLOSURE(method);
+		ObjBoundMethod* bound = instance->bound;
+
+		//callbacks read the same method again and again
+		if (bound == NULL || bound->method != closure) {
+			bound = newBoundMethod(vm.stackTop[-1], closure);
+			if (instance->bound != NULL) {
+				overwriteBarrier(OBJ_VAL(instance->bound));
+			}
+			instance->bound = bound;
+			writeBarrier(&instance->obj, OBJ_VAL(bound));
+		}
 		stack_replace(OBJ_VAL(bound));
 	}
 	else {
@@ -461,6 +573,71 @@ static void bindMethod(ObjClass* klass, ObjString* name) {
 	}
 }
 
+//guard: fields shadow methods,and other classes might have the same method name
+HOT_FUNCTION
+static bool isInlinedMethod(Value receiver, ObjString* name, ObjFunction* function) {
+	if (!IS_INSTANCE(receiver)) return false;
+
+	ObjInstance* instance = AS_INSTANCE(receiver);
+	Value method;
+
+	if (instance->klass == NULL || tableGet(&instance->fields, name, &method)) return false;
+	return tableGet(&instance->klass->methods, name, &method) && AS_CLOSURE(method)->function == function;
+}
+
+//the guard of inlined body failed,do the real call
+COLD_FUNCTION
+static bool callNotInlined(Value callee, int argCount) {
+	return callValue(callee, argCount);
+}
+
+COLD_FUNCTION
+static bool invokeNotInlined(ObjString* name, int argCount) {
+	return invoke(name, argCount);
+}
+
+//target[key](args) without the bound method,the key leaves the stack
+HOT_FUNCTION
+static bool invokeSubscript(int argCount) {
+	Value target = vm.stackTop[-2 - argCount];
+	Value key = STACK_PEEK(argCount);
+	Value* args = vm.stackTop - argCount;
+
+	memmove(args - 1, args, sizeof(Value) * argCount);
+	vm.stackTop--;
+
+	if (IS_INSTANCE(target)) {
+		if (!IS_STRING(key)) {
+			runtimeError("Instance subscript must be string.");
+			return false;
+		}
+		return invoke(AS_STRING(key), argCount);
+	}
+
+	if (IS_ARRAY(target)) {
+		if (!IS_NUMBER(key)) {
+			runtimeError("Array subscript must be number.");
+			return false;
+		}
+
+		ObjArray* array = AS_ARRAY(target);
+		double index = AS_NUMBER(key);
+		Value callee = ARRAY_IN_RANGE(array, index) ? array->elements[(uint32_t)index] : NIL_VAL;
+
+		STACK_PEEK(argCount) = callee;
+		return callValue(callee, argCount);
+	}
+
+	//a char of the string is a number
+	if (IS_STRING(target)) {
+		runtimeError(IS_NUMBER(key) ? "Can only call functions and classes." : "String subscript must be number.");
+		return false;
+	}
+
+	runtimeError("Only instances,array and string can get subscript.");
+	return false;
+}
+
 HOT_FUNCTION
 static ObjUpvalue* captureUpvalue(Value* local) {
 	ObjUpvalue* prevUpvalue = NULL;
@@ -496,8 +673,9 @@ static void closeUpvalues(Value* last) {
 		ObjUpvalue* upvalue = vm.openUpvalues;
 
 		//if one upValue closed,it's location is it's closed's pointer
-		upvalue->closed = *upvalue->location;
+		storeValue(&upvalue->closed, *upvalue->location);
 		upvalue->location = &upvalue->closed;
+		writeBarrier(&upvalue->obj, upvalue->closed);
 		vm.openUpvalues = upvalue->next;
 	}
 }
@@ -661,14 +839,21 @@ static InterpretResult run()
 			stack_push(OBJ_VAL(closure));
 
 			for (uint32_t i = 0; i < closure->upvalueCount; i++) {
-				uint8_t isLocal = READ_BYTE();
+				uint8_t captureType = READ_BYTE();
 				uint16_t index = READ_SHORT();
-				if (isLocal) {
-					closure->upvalues[i] = captureUpvalue(frame->slots + index);
-				}
-				else {
+				switch (captureType) {
+				case CAPTURE_LOCAL_FLAT:
+					closure->upvalues[i] = frame->slots[index];
+					break;
+				case CAPTURE_LOCAL:
+					closure->upvalues[i] = OBJ_VAL(captureUpvalue(frame->slots + index));
+					break;
+				default://flat value or shared upvalue
 					closure->upvalues[i] = frame->closure->upvalues[index];
+					break;
 				}
+				//captureUpvalue may promote the closure
+				writeBarrier(&closure->obj, closure->upvalues[i]);
 			}
 			break;
 		}
@@ -701,7 +886,7 @@ static InterpretResult run()
 			}
 			//don't throw error
 			if (instance->klass != NULL) {
-				bindMethod(instance->klass, name);
+				bindMethod(instance, name);
 			}
 			break;
 		}
@@ -714,8 +899,11 @@ static InterpretResult run()
 			ObjInstance* instance = AS_INSTANCE(vm.stackTop[-2]);
 			Value constant = READ_CONSTANT(READ_SHORT());
 			ObjString* name = AS_STRING(constant);
+			tableOverwriteBarrier(&instance->fields, name);
 			if (NOT_NIL(vm.stackTop[-1])) {
 				tableSet(&instance->fields, name, vm.stackTop[-1]);
+				writeBarrier(&instance->obj, OBJ_VAL(name));
+				writeBarrier(&instance->obj, vm.stackTop[-1]);
 			}
 			else {
 				tableDelete(&instance->fields, name);
@@ -724,6 +912,32 @@ static InterpretResult run()
 			stack_replace(value);
 			break;
 		}
+		case OP_GET_ELEM_UNCHECKED: {
+			//the loop condition has checked the array and the index
+			ObjArray* array = AS_ARRAY(vm.stackTop[-2]);
+			uint32_t index = (uint32_t)AS_NUMBER(vm.stackTop[-1]);
+
+			vm.stackTop--;
+			stack_replace(array->elements[index]);
+			break;
+		}
+		case OP_SET_ELEM_UNCHECKED: {
+			//the loop condition has checked the array and the index
+			ObjArray* array = AS_ARRAY(vm.stackTop[-3]);
+			uint32_t index = (uint32_t)AS_NUMBER(vm.stackTop[-2]);
+
+			overwriteBarrier(array->elements[index]);
+			storeValue(&array->elements[index], vm.stackTop[-1]);
+			vm.stackTop[-3] = vm.stackTop[-1];
+			writeBarrier(&array->obj, vm.stackTop[-1]);
+			vm.stackTop -= 2;
+			break;
+		}
+		case OP_FREE_LOCAL: {
+			Value value = frame->slots[READ_BYTE()];
+			if (IS_OBJ(value)) releaseObject(AS_OBJ(value));
+			break;
+		}
 		case OP_GET_SUBSCRIPT: {
 			Value target = vm.stackTop[-2];
 			Value index = vm.stackTop[-1];
@@ -761,7 +975,7 @@ static InterpretResult run()
 					}
 					//don't throw error
 					if (instance->klass != NULL) {
-						bindMethod(instance->klass, name);
+						bindMethod(instance, name);
 					}
 					break;
 				}
@@ -806,7 +1020,10 @@ static InterpretResult run()
 					double num_index = AS_NUMBER(index);
 
 					if (ARRAY_IN_RANGE(array, num_index)) {
-						vm.stackTop[-3] = array->elements[(uint32_t)num_index] = value;
+						overwriteBarrier(array->elements[(uint32_t)num_index]);
+						storeValue(&array->elements[(uint32_t)num_index], value);
+						vm.stackTop[-3] = value;
+						writeBarrier(&array->obj, value);
 						vm.stackTop -= 2;
 						break;
 					}
@@ -825,8 +1042,12 @@ static InterpretResult run()
 					ObjInstance* instance = AS_INSTANCE(target);
 					ObjString* name = AS_STRING(index);
 
+					tableOverwriteBarrier(&instance->fields, name);
 					if (NOT_NIL(vm.stackTop[-1])) {
 						tableSet(&instance->fields, name, value);
+						//the key may be a young runtime string
+						writeBarrier(&instance->obj, OBJ_VAL(name));
+						writeBarrier(&instance->obj, value);
 					}
 					else {
 						tableDelete(&instance->fields, name);
@@ -853,6 +1074,26 @@ static InterpretResult run()
 			vm.stackTop--;//can not dec first,because gc will kill it
 			break;
 		}
+		case OP_DEFINE_CONST_GLOBAL: {
+			ConstGlobal* global = &vm.constGlobals[READ_SHORT()];
+
+			//the code compiled before the declaration finds it by name
+			tableSet(&vm.globals.fields, global->name, vm.stackTop[-1]);
+			global->value = vm.stackTop[-1];
+			global->isDefined = true;
+			vm.stackTop--;//can not dec first,because gc will kill it
+			break;
+		}
+		case OP_GET_CONST_GLOBAL: {
+			ConstGlobal* global = &vm.constGlobals[READ_SHORT()];
+
+			if (!global->isDefined) {
+				runtimeError("Undefined variable '%s'.", global->name->chars);
+				return INTERPRET_RUNTIME_ERROR;
+			}
+			stack_push(global->value);
+			break;
+		}
 		case OP_GET_GLOBAL: {
 			Value constant = READ_CONSTANT(READ_SHORT());
 			ObjString* name = AS_STRING(constant);
@@ -900,21 +1141,16 @@ static InterpretResult run()
 		}
 		case OP_NEW_ARRAY: {
 			uint16_t size = READ_BYTE();
-			ObjArray* array = newArray();
-			//push to prevent gc
-			stack_push(OBJ_VAL(array));
+			//the elements are in the same block
+			ObjArray* array = newArray(size);
 
-			if (size > 0) {
-				reserveArray(array, size);//allocate after push stack
+			//no barrier,the array is new
+			memcpy(array->elements, vm.stackTop - size, sizeof(Value) * size);
+			array->length = size;
 
-				//init the array
-				memcpy(array->elements, vm.stackTop - size - 1, sizeof(Value) * size);
-				array->length = size;
-
-				//pop the values and the temp array at top
-				STACK_PEEK(size) = OBJ_VAL(array);
-				vm.stackTop -= size;
-			}
+			//pop the values
+			vm.stackTop -= size;
+			stack_push(OBJ_VAL(array));
 			break;
 		}
 		case OP_NEW_OBJECT: {
@@ -925,18 +1161,30 @@ static InterpretResult run()
 			ObjInstance* instance = AS_INSTANCE(vm.stackTop[-2]);
 			Value constant = READ_CONSTANT(READ_SHORT());
 			ObjString* name = AS_STRING(constant);
+			tableOverwriteBarrier(&instance->fields, name);
 			tableSet(&instance->fields, name, vm.stackTop[-1]);
+			writeBarrier(&instance->obj, OBJ_VAL(name));
+			writeBarrier(&instance->obj, vm.stackTop[-1]);
 			stack_pop();
 			break;
 		}
 		case OP_GET_UPVALUE: {
 			uint8_t slot = READ_BYTE();
-			stack_push(*frame->closure->upvalues[slot]->location);
+			Value value = frame->closure->upvalues[slot];
+			//not flat
+			if (IS_UPVALUE(value)) {
+				value = *AS_UPVALUE(value)->location;
+			}
+			stack_push(value);
 			break;
 		}
 		case OP_SET_UPVALUE: {
 			uint8_t slot = READ_BYTE();
-			*frame->closure->upvalues[slot]->location = vm.stackTop[-1];
+			//assigned captures are never flat
+			ObjUpvalue* upvalue = AS_UPVALUE(frame->closure->upvalues[slot]);
+			overwriteBarrier(*upvalue->location);
+			storeValue(upvalue->location, vm.stackTop[-1]);
+			writeBarrier(&upvalue->obj, vm.stackTop[-1]);
 			break;
 		}
 		case OP_NIL: stack_push(NIL_VAL); break;
@@ -1042,6 +1290,17 @@ static InterpretResult run()
 		case OP_LOOP: {
 			uint16_t offset = READ_SHORT();
 			ip -= offset;
+#if GC_COMPACT
+			//a safe point,nothing but the roots holds an object
+			if (vm.compactPending) compactHeap();
+#endif
+			if (vm.heapExhausted) {
+				heapLimitError();
+				return INTERPRET_RUNTIME_ERROR;
+			}
+#if defined(SNAPSHOT_SIGNAL)
+			if (snapshot_requested) snapshot_writeRequested();
+#endif
 			break;
 		}
 		case OP_JUMP_IF_FALSE: {
@@ -1086,7 +1345,23 @@ static InterpretResult run()
 			ip = frame->ip;//restore after call
 			break;
 		}
+		case OP_INVOKE_SUBSCRIPT: {
+			uint8_t argCount = READ_BYTE();
+
+			frame->ip = ip;//change before call
+			if (!invokeSubscript(argCount)) {
+				return INTERPRET_RUNTIME_ERROR;
+			}
+			//we entered the function
+			frame = &vm.frames[vm.frameCount - 1];
+			ip = frame->ip;//restore after call
+			break;
+		}
 		case OP_RETURN: {
+			if (vm.heapExhausted) {
+				heapLimitError();
+				return INTERPRET_RUNTIME_ERROR;
+			}
 			Value result = stack_pop();
 			//close all remaining upValues of function
 			closeUpvalues(frame->slots);
@@ -1103,6 +1378,12 @@ static InterpretResult run()
 
 			frame = &vm.frames[vm.frameCount - 1];
 			ip = frame->ip;
+#if GC_COMPACT
+			if (vm.compactPending) compactHeap();
+#endif
+#if defined(SNAPSHOT_SIGNAL)
+			if (snapshot_requested) snapshot_writeRequested();
+#endif
 			break;
 		}
 
@@ -1111,6 +1392,67 @@ static InterpretResult run()
 			stack_push(OBJ_VAL(&vm.builtins[moduleIndex]));
 			break;
 		}
+		case OP_CALL_INLINE: {
+			uint8_t argCount = READ_BYTE();
+			ObjFunction* function = AS_FUNCTION(READ_CONSTANT(READ_SHORT()));
+			uint16_t bodySize = READ_SHORT();
+			Value callee = STACK_PEEK(argCount);
+
+			//guard: the global might be reassigned
+			if (IS_CLOSURE(callee) && AS_CLOSURE(callee)->function == function) {
+				vm.inlineFunction = function;
+				vm.inlineBegin = ip;
+				vm.inlineSlots = vm.stackTop - argCount - 1;
+				break;
+			}
+
+			frame->ip = ip + bodySize;//change before call,skip the body
+			if (!callNotInlined(callee, argCount)) {
+				return INTERPRET_RUNTIME_ERROR;
+			}
+			frame = &vm.frames[vm.frameCount - 1];
+			ip = frame->ip;//restore after call
+			break;
+		}
+		case OP_INVOKE_INLINE: {
+			ObjString* name = AS_STRING(READ_CONSTANT(READ_SHORT()));
+			uint8_t argCount = READ_BYTE();
+			ObjFunction* function = AS_FUNCTION(READ_CONSTANT(READ_SHORT()));
+			uint16_t bodySize = READ_SHORT();
+			Value receiver = STACK_PEEK(argCount);
+
+			if (isInlinedMethod(receiver, name, function)) {
+				vm.inlineFunction = function;
+				vm.inlineBegin = ip;
+				vm.inlineSlots = vm.stackTop - argCount - 1;
+				break;
+			}
+
+			frame->ip = ip + bodySize;//change before call,skip the body
+			if (!invokeNotInlined(name, argCount)) {
+				return INTERPRET_RUNTIME_ERROR;
+			}
+			frame = &vm.frames[vm.frameCount - 1];
+			ip = frame->ip;//restore after call
+			break;
+		}
+		case OP_GET_INLINE_LOCAL: {
+			uint32_t index = READ_BYTE();
+			stack_push(vm.inlineSlots[index]);
+			break;
+		}
+		case OP_RETURN_INLINE: {
+			//the same as OP_RETURN,but no frame to pop
+			*vm.inlineSlots = vm.stackTop[-1];
+			vm.stackTop = vm.inlineSlots + 1;
+			vm.inlineFunction = NULL;
+			break;
+		}
+		case OP_FREE_INLINE_LOCAL: {
+			Value value = vm.inlineSlots[READ_BYTE()];
+			if (IS_OBJ(value)) releaseObject(AS_OBJ(value));
+			break;
+		}
 		}
 	}
 
@@ -1124,7 +1466,13 @@ static InterpretResult run()
 
 InterpretResult interpret(C_STR source)
 {
+#if LOG_COMPILE_TIME
+	clock_t compileStart = clock();
+#endif
 	ObjFunction* function = compile(source);
+#if LOG_COMPILE_TIME
+	double compileTime = (double)(clock() - compileStart) / CLOCKS_PER_SEC;
+#endif
 	if (function == NULL) return INTERPRET_COMPILE_ERROR;
 
 	//stack_push(OBJ_VAL(function));
@@ -1133,7 +1481,16 @@ InterpretResult interpret(C_STR source)
 	stack_push(OBJ_VAL(closure));
 	call(closure, 0);
 
+#if LOG_COMPILE_TIME
+	vm.lazyCompileTime = 0;
+	clock_t runStart = clock();
+#endif
 	InterpretResult result = run();
+#if LOG_COMPILE_TIME
+	double runTime = (double)(clock() - runStart) / CLOCKS_PER_SEC;
+	printf("[time] compile %.3f ms, run %.3f ms (lazy compile %.3f ms)\n",
+		compileTime * 1000, (runTime - vm.lazyCompileTime) * 1000, vm.lazyCompileTime * 1000);
+#endif
 	return result;
 }
 
@@ -8,6 +8,7 @@
 #include "compiler.h"
 #include "table.h"
 #include "object.h"
+#include "heap.h"
 #include "nativeBuiltin.h"
 
 //the depth of call frames
@@ -15,6 +16,14 @@
 #define STACK_INITIAL_SIZE (1024)
 #define STACK_MAX_SIZE (FRAMES_MAX * LOCAL_MAX)
 
+//global constant,the slot is assigned by the compiler
+typedef struct {
+	ObjString* name;
+	Value value;
+	bool isLiteral; //the value is known when compiling
+	bool isDefined; //the declaration has been executed
+} ConstGlobal;
+
 typedef struct {
 	ObjClosure* closure;
 	uint8_t* ip;
@@ -43,24 +52,73 @@ typedef struct {
 	ObjInstance globals;
 	ObjInstance builtins[BUILTIN_MODULE_COUNT];
 
-	//the root for dynamic objects
-	Obj* objects;
-	//the root for static objects
-	Obj* objects_no_gc;
+	//global constants
+	Table constGlobalSlots; //name -> slot
+	uint32_t constGlobalCount;
+	uint32_t constGlobalCapacity;
+	ConstGlobal* constGlobals;
+
+	//the pages of dynamic objects
+	HeapPage* pages;
+	//the pages with dynamic objects allocated after the last collection
+	HeapPage* youngPages;
+	//static objects
+	uint64_t staticCount;
+	uint64_t staticCapacity;
+	Obj** staticObjects;
 
 	//gc gray objects
 	uint64_t grayCount;
 	uint64_t grayCapacity;
 	Obj** grayStack;
 
+	//old objects that store young ones
+	uint64_t rememberedCount;
+	uint64_t rememberedCapacity;
+	Obj** rememberedSet;
+
+	//runtime strings interned after the last collection
+	uint64_t youngStringCount;
+	uint64_t youngStringCapacity;
+	ObjString** youngStrings;
+
+	//values dropped while the marking thread runs
+	uint64_t overwrittenCount;
+	uint64_t overwrittenCapacity;
+	Obj** overwrittenSet;
+
 	//Excludes space used by stacks/constants/compilations
 	uint64_t bytesAllocated_no_gc;
 	uint64_t bytesAllocated;
 	uint64_t nextGC;
+	uint64_t nextMinorGC;
+#if LARGE_SPACE
+	//the large buffers are not in bytesAllocated
+	uint64_t nextLargeGC;
+#endif
+	//the incremental major gc
+	uint64_t lastGCStep;
+	uint64_t nextGCStep;
+#if GC_COMPACT
+	//set by a major gc,the interpreter compacts at the next safe point
+	bool compactPending;
+#endif
+	//a full gc couldn't get under the heap limit,the interpreter raises an error at the next safe point
+	bool heapExhausted;
 
 	//ip for debug error
 	uint8_t** ip_error;
 
+#if LOG_COMPILE_TIME
+	//seconds spent compiling lazy functions during run
+	double lazyCompileTime;
+#endif
+
+	//the inlined function being executed,null if none
+	ObjFunction* inlineFunction;
+	uint8_t* inlineBegin; //first instruction of the inlined body
+	Value* inlineSlots; //callee of the inlined body
+
 	//literal object
 	ObjClass emptyClass;
 